@@ -0,0 +1,146 @@
+/*
+ *  OpenVPN-GUI -- A Windows GUI for OpenVPN.
+ *
+ *  Copyright (C) 2013 Heiko Hund <heikoh@users.sf.net>
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program (see the file COPYING included with this
+ *  distribution); if not, write to the Free Software Foundation, Inc.,
+ *  59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+#ifdef HAVE_CONFIG_H
+#include <config.h>
+#endif
+
+#include <string.h>
+
+#include "codec.h"
+
+static const char b64_chars[] =
+    "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789+/";
+
+/* value + 1 of base64 digits, 0 for other characters */
+static const unsigned char b64_value[256] = {
+    ['A'] = 1, ['B'] = 2, ['C'] = 3, ['D'] = 4, ['E'] = 5, ['F'] = 6, ['G'] = 7, ['H'] = 8,
+    ['I'] = 9, ['J'] = 10, ['K'] = 11, ['L'] = 12, ['M'] = 13, ['N'] = 14, ['O'] = 15, ['P'] = 16,
+    ['Q'] = 17, ['R'] = 18, ['S'] = 19, ['T'] = 20, ['U'] = 21, ['V'] = 22, ['W'] = 23, ['X'] = 24,
+    ['Y'] = 25, ['Z'] = 26, ['a'] = 27, ['b'] = 28, ['c'] = 29, ['d'] = 30, ['e'] = 31, ['f'] = 32,
+    ['g'] = 33, ['h'] = 34, ['i'] = 35, ['j'] = 36, ['k'] = 37, ['l'] = 38, ['m'] = 39, ['n'] = 40,
+    ['o'] = 41, ['p'] = 42, ['q'] = 43, ['r'] = 44, ['s'] = 45, ['t'] = 46, ['u'] = 47, ['v'] = 48,
+    ['w'] = 49, ['x'] = 50, ['y'] = 51, ['z'] = 52, ['0'] = 53, ['1'] = 54, ['2'] = 55, ['3'] = 56,
+    ['4'] = 57, ['5'] = 58, ['6'] = 59, ['7'] = 60, ['8'] = 61, ['9'] = 62, ['+'] = 63, ['/'] = 64,
+};
+
+/* value + 1 of hex digits, 0 for other characters */
+static const unsigned char hex_value[256] = {
+    ['0'] = 1, ['1'] = 2, ['2'] = 3, ['3'] = 4, ['4'] = 5, ['5'] = 6, ['6'] = 7, ['7'] = 8,
+    ['8'] = 9, ['9'] = 10, ['a'] = 11, ['b'] = 12, ['c'] = 13, ['d'] = 14, ['e'] = 15, ['f'] = 16,
+    ['A'] = 11, ['B'] = 12, ['C'] = 13, ['D'] = 14, ['E'] = 15, ['F'] = 16,
+};
+
+int
+base64_encode(const void *in, size_t len, char *out, size_t size)
+{
+    const unsigned char *p = in;
+    char *o = out;
+
+    if (size < BASE64_ENCODE_SIZE(len))
+    {
+        return -1;
+    }
+
+    for ( ; len >= 3; p += 3, len -= 3)
+    {
+        unsigned int v = (unsigned int) p[0] << 16 | (unsigned int) p[1] << 8 | p[2];
+        *o++ = b64_chars[v >> 18];
+        *o++ = b64_chars[(v >> 12) & 0x3F];
+        *o++ = b64_chars[(v >> 6) & 0x3F];
+        *o++ = b64_chars[v & 0x3F];
+    }
+    if (len > 0)
+    {
+        unsigned int v = (unsigned int) p[0] << 16 | (len > 1 ? (unsigned int) p[1] << 8 : 0);
+        *o++ = b64_chars[v >> 18];
+        *o++ = b64_chars[(v >> 12) & 0x3F];
+        *o++ = (len > 1) ? b64_chars[(v >> 6) & 0x3F] : '=';
+        *o++ = '=';
+    }
+    *o = '\0';
+
+    return (int) (o - out);
+}
+
+int
+base64_decode(const char *in, size_t len, void *out, size_t size)
+{
+    unsigned char *o = out;
+    size_t n = 0;               /* bytes written */
+    unsigned int v = 0;         /* accumulated bits */
+    int bits = 0;               /* number of accumulated bits */
+    int pad = 0;                /* number of '=' seen */
+
+    for (size_t i = 0; i < len; i++)
+    {
+        unsigned char ch = (unsigned char) in[i];
+        unsigned int d = b64_value[ch];
+
+        if (ch == ' ' || ch == '\t' || ch == '\r' || ch == '\n')
+        {
+            continue;
+        }
+        else if (ch == '=')
+        {
+            pad++;
+            continue;
+        }
+        else if (d == 0 || pad > 0)
+        {
+            return -1; /* not a base64 digit or data after padding */
+        }
+
+        v = v << 6 | (d - 1);
+        bits += 6;
+        if (bits >= 8)
+        {
+            bits -= 8;
+            if (n == size)
+            {
+                return -1;
+            }
+            o[n++] = (unsigned char) (v >> bits);
+            v &= (1u << bits) - 1;
+        }
+    }
+
+    /* a single digit left over or too much padding cannot be valid */
+    if (bits >= 6 || pad > 2)
+    {
+        return -1;
+    }
+    return (int) n;
+}
+
+unsigned char
+url_decode_char(const char **s)
+{
+    const unsigned char *p = (const unsigned char *) *s;
+
+    if (p[0] == '%' && hex_value[p[1]] && hex_value[p[2]])
+    {
+        *s += 3;
+        return (unsigned char) ((hex_value[p[1]] - 1) << 4 | (hex_value[p[2]] - 1));
+    }
+    *s += 1;
+    return p[0];
+}
@@ -0,0 +1,59 @@
+/*
+ *  OpenVPN-GUI -- A Windows GUI for OpenVPN.
+ *
+ *  Copyright (C) 2013 Heiko Hund <heikoh@users.sf.net>
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program (see the file COPYING included with this
+ *  distribution); if not, write to the Free Software Foundation, Inc.,
+ *  59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+#ifndef CODEC_H
+#define CODEC_H
+
+/*
+ * Base64 and url (percent) encoding used in the management protocol.
+ * Results are written to caller provided buffers. Only the C library
+ * is used.
+ */
+
+#include <stddef.h>
+
+/* Size of buffer needed to base64 encode n bytes, including the nul terminator */
+#define BASE64_ENCODE_SIZE(n) (((n) + 2) / 3 * 4 + 1)
+
+/* Size of buffer enough to decode n characters of base64 input */
+#define BASE64_DECODE_SIZE(n) ((n) / 4 * 3 + 2)
+
+/*
+ * Base64 encode len bytes from in and write the nul-terminated result
+ * to out. Returns the length of the result excluding nul or -1 if
+ * size is less than BASE64_ENCODE_SIZE(len).
+ */
+int base64_encode(const void *in, size_t len, char *out, size_t size);
+
+/*
+ * Decode len characters of base64 input. Whitespace is ignored and
+ * padding is optional. Returns the number of bytes written to out or
+ * -1 if the input is invalid or does not fit in size bytes.
+ */
+int base64_decode(const char *in, size_t len, void *out, size_t size);
+
+/*
+ * Return the next byte of the url-encoded string at *s and advance *s
+ * past it. A % not followed by two hex digits is passed through as is.
+ */
+unsigned char url_decode_char(const char **s);
+
+#endif /* ifndef CODEC_H */
@@ -29,159 +29,123 @@
 #include "config_parser.h"
 
 static int
-legal_escape(wchar_t c)
+legal_escape(char c)
 {
-    wchar_t *escapes = L"\" \\"; /* ", space, and backslash */
-    return (wcschr(escapes, c) != NULL);
+    return (c == '"' || c == ' ' || c == '\\');
 }
 
 static int
-is_comment(wchar_t *s)
+is_comment(const char *s)
 {
-    wchar_t *comment_chars = L";#";
-    return (s && (wcschr(comment_chars, s[0]) != NULL));
+    return (*s == ';' || *s == '#');
 }
 
+/*
+ * Get the next token of the line at *pos. The token is unquoted and
+ * unescaped in place -- the result is never longer than the input --
+ * and nul-terminated. Returns 1 if a token is found, 0 at the end of
+ * the line or a comment, and -1 on parse error.
+ */
 static int
-copy_token(wchar_t **dest, wchar_t **src, wchar_t *delim)
+next_token(char **pos, char **token)
 {
-    wchar_t *p = *src;
-    wchar_t *s = *dest;
+    char *p = *pos + strspn(*pos, " \t");
+    char *d = p;
 
-    /* copy src to dest until delim character with escaped chars converted */
-    for ( ; *p != L'\0' && wcschr(delim, *p) == NULL; p++, s++)
+    if (*p == '\0' || is_comment(p))
     {
-        if (*p == L'\\' && legal_escape(*(p+1)))
-        {
-            *s = *(++p);
-        }
-        else if (*p == L'\\')
-        {
-            MsgToEventLog(EVENTLOG_ERROR_TYPE, L"Parse error in copy_token: illegal backslash");
-            return -1; /* parse error -- illegal backslash in input */
-        }
-        else
-        {
-            *s = *p;
-        }
+        *pos = p;
+        return 0;
     }
-    /* at this point p is one of the delimiters or null */
-    *s = L'\0';
-    *src = p;
-    *dest = s;
-    return 0;
-}
+    *token = d;
 
-static int
-tokenize(config_entry_t *ce)
-{
-    wchar_t *p, *s;
-    p = ce->line;
-    s = ce->sline;
-    unsigned int i = 0;
-    int status = 0;
-
-    for ( ; *p != L'\0'; p++, s++)
+    if (*p == '\'')
     {
-        if (*p == L' ' || *p == L'\t')
-        {
-            continue;
-        }
-
-        if (_countof(ce->tokens) <= i)
-        {
-            return -1;
-        }
-        ce->tokens[i++] = s;
-
-        if (*p == L'\'')
+        /* single quoted -- no escapes */
+        for (p++; *p && *p != '\''; )
         {
-            int len = wcscspn(++p, L"\'");
-            wcsncpy(s, p, len);
-            s += len;
-            p += len;
+            *d++ = *p++;
         }
-        else if (*p == L'\"')
-        {
-            p++;
-            status = copy_token(&s, &p, L"\"");
-        }
-        else if (is_comment(p))
-        {
-            /* store rest of the line as comment -- remove from tokens */
-            ce->comment = s;
-            wcsncpy(s, p, wcslen(p));
-            ce->tokens[--i] = NULL;
-            break;
-        }
-        else
-        {
-            status = copy_token(&s, &p, L" \t");
-        }
-
-        if (status != 0)
+    }
+    else
+    {
+        char quote = (*p == '"') ? *p++ : '\0';
+        for ( ; *p && (quote ? *p != quote : (*p != ' ' && *p != '\t')); p++)
         {
-            return status;
+            if (*p == '\\' && legal_escape(p[1]))
+            {
+                p++;
+            }
+            else if (*p == '\\')
+            {
+                return -1; /* parse error -- illegal backslash in input */
+            }
+            *d++ = *p;
         }
+    }
 
-        if (*p == L'\0')
-        {
-            break;
-        }
+    /* p is at the closing quote, a separator or the end of line */
+    if (*p)
+    {
+        p++;
     }
-    ce->ntokens = i;
-    return 0;
+    *d = '\0';
+    *pos = p;
+    return 1;
 }
 
-config_entry_t *
-config_readline(FILE *fd, int first)
+static BOOL
+is_directive(const char *name, const char *const *directives)
 {
-    int len;
-    char tmp[MAX_LINE_LENGTH];
-    int offset = 0;
-
-    if (fgets(tmp, _countof(tmp)-1, fd) == NULL)
+    if (!directives)
     {
-        return NULL;
+        return true;
     }
-    /* remove UTF-8 BOM */
-    if (first && strncmp(tmp, "\xEF\xBB\xBF", 3) == 0)
+    for ( ; *directives; directives++)
     {
-        offset = 3;
-    }
-
-    config_entry_t *ce = calloc(sizeof(*ce), 1);
-    if (!ce)
-    {
-        MsgToEventLog(EVENTLOG_ERROR_TYPE, L"Out of memory in config_readline");
-        return NULL;
+        if (strcmp(name, *directives) == 0)
+        {
+            return true;
+        }
     }
+    return false;
+}
 
-    mbstowcs(ce->line, &tmp[offset], _countof(ce->line)-1);
-
-    len = wcscspn(ce->line, L"\n\r");
-    ce->line[len] = L'\0';
-
-    if (tokenize(ce) != 0)
+/*
+ * Read the next line into buf removing the line end. Overlong lines are
+ * truncated and the rest is discarded. Returns false at end of file.
+ */
+static BOOL
+read_line(FILE *fd, char *buf, int size)
+{
+    if (fgets(buf, size, fd) == NULL)
     {
-        free(ce);
-        return NULL;
+        return false;
     }
 
-    /* skip leading "--" in first token if any */
-    if (ce->ntokens > 0)
+    size_t len = strcspn(buf, "\r\n");
+    if (buf[len] == '\0' && !feof(fd))
     {
-        ce->tokens[0] += wcsspn(ce->tokens[0], L"--");
+        /* line does not fit -- skip to its end */
+        char tmp[64];
+        while (fgets(tmp, sizeof(tmp), fd) && tmp[strcspn(tmp, "\n")] != '\n')
+        {
+        }
     }
-
-    return ce;
+    buf[len] = '\0';
+    return true;
 }
 
-config_entry_t *
-config_parse(wchar_t *fname)
+int
+config_query(const wchar_t *fname, const char *const *directives,
+             config_query_fn fn, void *arg)
 {
+    char line[4*MAX_LINE_LENGTH]; /* UTF-8 takes up to 4 bytes per character */
+    char inline_end[MAX_LINE_LENGTH] = ""; /* closing tag of the inline block being skipped */
+    char *tokens[MAX_LINE_TOKENS];
     FILE *fd = NULL;
-    config_entry_t *head, *tail;
+    int lineno = 0;
+    int ret = 0;
 
     if (fname)
     {
@@ -189,29 +153,72 @@ config_parse(wchar_t *fname)
     }
     if (!fd)
     {
-        MsgToEventLog(EVENTLOG_ERROR_TYPE, L"Error opening <%ls> in config_parse", fname);
-        return NULL;
+        MsgToEventLog(EVENTLOG_ERROR_TYPE, L"Error opening <%ls> in config_query", fname);
+        return -1;
     }
-    head = tail = config_readline(fd, 1);
 
-    while (tail)
+    while (ret == 0 && read_line(fd, line, sizeof(line)))
     {
-        tail->next = config_readline(fd, 0);
-        tail = tail->next;
-    }
-    fclose(fd);
-    return head;
-}
+        char *p = line;
+        int ntokens = 0;
+        int status;
 
-void
-config_list_free(config_entry_t *head)
-{
-    config_entry_t *next;
-    while (head)
-    {
-        next = head->next;
-        free(head);
-        head = next;
+        /* remove UTF-8 BOM */
+        if (++lineno == 1 && strncmp(p, "\xEF\xBB\xBF", 3) == 0)
+        {
+            p += 3;
+        }
+
+        if (inline_end[0])
+        {
+            p += strspn(p, " \t");
+            if (strncmp(p, inline_end, strlen(inline_end)) == 0)
+            {
+                inline_end[0] = '\0';
+            }
+            continue;
+        }
+
+        status = next_token(&p, &tokens[0]);
+        if (status == 1)
+        {
+            size_t len = strlen(tokens[0]);
+            if (tokens[0][0] == '<' && tokens[0][1] != '/' && tokens[0][len - 1] == '>'
+                && strcmp(tokens[0], "<connection>") != 0)
+            {
+                /* start of an inline file: skip to </tag> -- <connection> blocks hold options */
+                _snprintf_0(inline_end, "</%s", tokens[0] + 1);
+                continue;
+            }
+            tokens[0] += strspn(tokens[0], "-");
+            if (!is_directive(tokens[0], directives))
+            {
+                continue;
+            }
+            ntokens = 1;
+        }
+
+        while (status == 1 && ntokens < MAX_LINE_TOKENS
+               && (status = next_token(&p, &tokens[ntokens])) == 1)
+        {
+            ntokens++;
+        }
+        char *extra;
+        if (status == 1 && next_token(&p, &extra) == 1)
+        {
+            status = -1; /* too many tokens */
+        }
+
+        if (status < 0)
+        {
+            MsgToEventLog(EVENTLOG_ERROR_TYPE, L"Parse error in <%ls> at line %d", fname, lineno);
+        }
+        else if (ntokens > 0)
+        {
+            ret = fn(arg, tokens, ntokens);
+        }
     }
-    return;
+
+    fclose(fd);
+    return ret;
 }
@@ -22,34 +22,36 @@
 #ifndef CONFIG_PARSER_H
 #define CONFIG_PARSER_H
 
+/* Max length of a config line in characters -- same as in openvpn */
 #define MAX_LINE_LENGTH 256
 
-typedef struct config_entry config_entry_t;
-
-struct config_entry {
-    wchar_t line[MAX_LINE_LENGTH];
-    wchar_t sline[MAX_LINE_LENGTH];
-    wchar_t *tokens[16];
-    wchar_t *comment;
-    int ntokens;
-    config_entry_t *next;
-};
+/* Max number of tokens in a config line */
+#define MAX_LINE_TOKENS 16
 
 /**
- * Parse an ovpn file into a list of tokenized
- * structs.
- * @param fname : filename of the config to parse
- * @returns the pointer to the head of a list of
- *          config_entry_t structs.
- *          The called must free it after use by calling
- *          config_list_free()
+ * Callback for config_query(): called with the tokens of a matching
+ * line. Tokens are nul-terminated UTF-8 strings with quotes and escapes
+ * removed and the leading "--" of the first token skipped. They are
+ * valid only during the call.
+ * @param arg : the arg passed to config_query()
+ * @returns 0 to continue or a nonzero value to stop parsing
  */
-config_entry_t *config_parse(wchar_t *fname);
+typedef int (*config_query_fn)(void *arg, char **tokens, int ntokens);
 
 /**
- * Free a list of config_entry_t structs
- * @param head : list head returned by config_parse()
+ * Parse an ovpn file line by line and call fn for each directive in
+ * the list. Lines are read into a fixed buffer and tokenized in place,
+ * only if the directive matches, so nothing is allocated. Comments and
+ * the content of inline blocks such as <ca>...</ca> are skipped.
+ * @param fname : filename of the config to parse
+ * @param directives : NULL-terminated list of directive names or NULL
+ *                     to match all lines
+ * @param fn : callback for matching lines
+ * @param arg : passed to fn
+ * @returns -1 if the file could not be read, else the nonzero value
+ *          returned by fn if it stopped parsing, or 0
  */
-void config_list_free(config_entry_t *head);
+int config_query(const wchar_t *fname, const char *const *directives,
+                 config_query_fn fn, void *arg);
 
 #endif /* ifndef CONFIG_PARSER_H */
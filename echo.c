@@ -35,6 +35,7 @@
 #include "openvpn-gui-res.h"
 #include "localization.h"
 #include "registry.h"
+#include "codec.h"
 
 extern options_t o;
 
@@ -45,11 +46,6 @@ extern options_t o;
 /* Old text in the window is deleted when content grows beyond this many lines */
 #define MAX_MSG_LINES 1000
 
-struct echo_msg_history {
-    struct echo_msg_fp fp;
-    struct echo_msg_history *next;
-};
-
 /* We use a global message window for all messages
  */
 static HWND echo_msg_window;
@@ -72,87 +68,48 @@ echo_msg_init(void)
     }
 }
 
-/* compute a digest of the message and add it to the msg struct */
+/*
+ * Complete the digest of the message by adding the title and save it
+ * in the msg struct. The text is hashed as it is appended.
+ */
 static void
 echo_msg_add_fp(struct echo_msg *msg, time_t timestamp)
 {
-    md_ctx ctx;
-
     msg->fp.timestamp = timestamp;
-    if (md_init(&ctx, CALG_SHA1) != 0)
-    {
-        return;
-    }
-    md_update(&ctx, (BYTE *) msg->text, msg->txtlen*sizeof(msg->text[0]));
-    md_update(&ctx, (BYTE *) msg->title, wcslen(msg->title)*sizeof(msg->title[0]));
-    md_final(&ctx, msg->fp.digest);
-    return;
-}
-
-/* find message with given digest in history */
-static struct echo_msg_history *
-echo_msg_recall(const BYTE *digest, struct echo_msg_history *hist)
-{
-    for (; hist; hist = hist->next)
-    {
-        if (memcmp(hist->fp.digest, digest, HASHLEN) == 0)
-        {
-            break;
-        }
-    }
-    return hist;
-}
-
-/* Add an item to message history and return the head of the list */
-static struct echo_msg_history *
-echo_msg_history_add(struct echo_msg_history *head, const struct echo_msg_fp *fp)
-{
-    struct echo_msg_history *hist = malloc(sizeof(struct echo_msg_history));
-    if (hist)
+    if (msg->txtlen == 0)
     {
-        memcpy(&hist->fp, fp, sizeof(*fp));
-        hist->next = head;
-        head = hist;
+        sha1_init(&msg->md);
     }
-    return head;
+    sha1_update(&msg->md, msg->title, wcslen(msg->title)*sizeof(msg->title[0]));
+    sha1_final(&msg->md, msg->fp.digest);
 }
 
 /* Save message in history -- update if already present */
 static void
 echo_msg_save(struct echo_msg *msg)
 {
-    struct echo_msg_history *hist = echo_msg_recall(msg->fp.digest, msg->history);
-    if (hist) /* update */
+    if (!msg->history && !(msg->history = echo_msg_history_new()))
     {
-        hist->fp.timestamp = msg->fp.timestamp;
-    }
-    else     /* add */
-    {
-        msg->history = echo_msg_history_add(msg->history, &msg->fp);
+        return;
     }
+
+    /* drop items that can no longer mute a message received now */
+    echo_msg_history_expire(msg->history, msg->fp.timestamp - o.popup_mute_interval*3600);
+    echo_msg_history_save(msg->history, &msg->fp);
 }
 
-/* persist echo msg history to the registry */
+/* persist echo msg history to the registry -- most recently shown first */
 void
 echo_msg_persist(connection_t *c)
 {
-    struct echo_msg_history *hist;
-    size_t len = 0;
+    struct echo_msg_history *hist = c->echo_msg.history;
 
-    for (hist = c->echo_msg.history; hist; hist = hist->next)
-    {
-        len++;
-        if (len > 99)
-        {
-            break;           /* max 100 history items persisted */
-        }
-    }
-    if (len == 0)
+    if (!hist || hist->count == 0)
     {
         return;
     }
 
-    size_t size = len*sizeof(struct echo_msg_fp);
+    size_t size = hist->count*sizeof(struct echo_msg_fp);
     struct echo_msg_fp *data = malloc(size);
     if (data == NULL)
     {
@@ -160,11 +117,7 @@ echo_msg_persist(connection_t *c)
         return;
     }
 
-    size_t i = 0;
-    for (hist = c->echo_msg.history; i < len && hist; hist = hist->next)
-    {
-        data[i++] = hist->fp;
-    }
+    echo_msg_history_list(hist, data);
     if (!SetConfigRegistryValueBinary(c->config_name, L"echo_msg_history", (BYTE *) data, size))
     {
         WriteStatusLog(c, L"GUI> ", L"Failed to persist echo msg history: error writing to registry", false);
@@ -197,13 +150,13 @@ echo_msg_load(connection_t *c)
     {
         goto out;
     }
-
-    size_t len = size/item_len;
-    for (size_t i = 0; i < len; i++)
+    if (!c->echo_msg.history && !(c->echo_msg.history = echo_msg_history_new()))
     {
-        c->echo_msg.history = echo_msg_history_add(c->echo_msg.history, &data[i]);
+        goto out;
     }
 
+    echo_msg_history_restore(c->echo_msg.history, data, size/item_len);
+
 out:
     free(data);
 }
@@ -212,56 +165,165 @@ out:
 static BOOL
 echo_msg_repeated(const struct echo_msg *msg)
 {
-    const struct echo_msg_history *hist;
+    int n = echo_msg_history_find(msg->history, msg->fp.digest);
 
-    hist = echo_msg_recall(msg->fp.digest, msg->history);
-    return (hist && (hist->fp.timestamp + o.popup_mute_interval*3600 > msg->fp.timestamp));
+    return (n >= 0 && (msg->history->fp[n].timestamp + o.popup_mute_interval*3600 > msg->fp.timestamp));
 }
 
-/* Append a line of echo msg */
-static void
-echo_msg_append(connection_t *c, time_t UNUSED timestamp, const char *msg, BOOL addnl)
+/*
+ * Decode the url-encoded UTF-8 string s into UTF-16 in a single pass.
+ * Invalid UTF-8 sequences are replaced by U+FFFD and decoding stops at
+ * an encoded nul. The output is not nul-terminated and is never longer
+ * than strlen(s) characters. Returns the number of characters written.
+ */
+static size_t
+url_decode_utf16(WCHAR *out, const char *s)
 {
-    wchar_t *eol = L"";
-    wchar_t *wmsg = NULL;
+    WCHAR *w = out;
 
-    if (!(wmsg = Widen(msg)))
+    while (*s)
     {
-        WriteStatusLog(c, L"GUI> ", L"Error: out of memory while processing echo msg", false);
-        goto out;
+        unsigned int c = url_decode_char(&s);
+        unsigned int cp;
+        unsigned int lo = 0x80, hi = 0xBF; /* range of the first continuation byte */
+        int n;
+
+        if (c == 0)
+        {
+            break;
+        }
+        else if (c < 0x80)
+        {
+            *w++ = (WCHAR) c;
+            continue;
+        }
+        else if (c >= 0xC2 && c <= 0xDF)
+        {
+            n = 1;
+            cp = c & 0x1F;
+        }
+        else if (c >= 0xE0 && c <= 0xEF)
+        {
+            n = 2;
+            cp = c & 0x0F;
+            lo = (c == 0xE0) ? 0xA0 : lo; /* no overlong forms */
+            hi = (c == 0xED) ? 0x9F : hi; /* no surrogates */
+        }
+        else if (c >= 0xF0 && c <= 0xF4)
+        {
+            n = 3;
+            cp = c & 0x07;
+            lo = (c == 0xF0) ? 0x90 : lo; /* no overlong forms */
+            hi = (c == 0xF4) ? 0x8F : hi; /* nothing above U+10FFFF */
+        }
+        else
+        {
+            *w++ = 0xFFFD;
+            continue;
+        }
+
+        /* continuation bytes -- a byte that is not one is left for the next character */
+        for ( ; n > 0 && *s; n--)
+        {
+            const char *p = s;
+            unsigned int cc = url_decode_char(&p);
+            if (cc < lo || cc > hi)
+            {
+                break;
+            }
+            cp = cp << 6 | (cc & 0x3F);
+            lo = 0x80;
+            hi = 0xBF;
+            s = p;
+        }
+
+        if (n > 0)
+        {
+            *w++ = 0xFFFD;
+        }
+        else if (cp >= 0x10000)
+        {
+            cp -= 0x10000;
+            *w++ = (WCHAR) (0xD800 | cp >> 10);
+            *w++ = (WCHAR) (0xDC00 | (cp & 0x3FF));
+        }
+        else
+        {
+            *w++ = (WCHAR) cp;
+        }
     }
+    return w - out;
+}
 
-    size_t len = c->echo_msg.txtlen + wcslen(wmsg) + 1;  /* including null terminator */
-    if (addnl)
+/*
+ * Make room for n more characters and a nul terminator in the message
+ * text. The buffer grows geometrically so that appending many lines
+ * does not copy the text over and over.
+ */
+static BOOL
+echo_msg_reserve(struct echo_msg *msg, size_t n)
+{
+    size_t need = msg->txtlen + n + 1;
+    size_t size = msg->txtsize;
+
+    if (need <= size)
     {
-        eol = L"\r\n";
-        len += 2;
+        return true;
     }
-    WCHAR *s = realloc(c->echo_msg.text, len*sizeof(WCHAR));
+    for (size = max(size, 256); size < need; size *= 2)
+    {
+    }
+
+    WCHAR *s = realloc(msg->text, size*sizeof(WCHAR));
     if (!s)
+    {
+        return false;
+    }
+    msg->text = s;
+    msg->txtsize = (int) size;
+    return true;
+}
+
+/* Append a line of echo msg -- msg is url-encoded UTF-8 */
+static void
+echo_msg_append(connection_t *c, time_t UNUSED timestamp, const char *msg, BOOL addnl)
+{
+    struct echo_msg *m = &c->echo_msg;
+
+    /* the decoded line is never longer than the encoded one */
+    if (!echo_msg_reserve(m, strlen(msg) + 2))
     {
         WriteStatusLog(c, L"GUI> ", L"Error: out of memory while processing echo msg", false);
-        goto out;
+        return;
     }
-    swprintf(s + c->echo_msg.txtlen, len - c->echo_msg.txtlen,  L"%ls%ls", wmsg, eol);
 
-    s[len-1] = L'\0';
-    c->echo_msg.text = s;
-    c->echo_msg.txtlen = len - 1; /* exclude null terminator */
+    int start = m->txtlen;
+    if (start == 0)
+    {
+        sha1_init(&m->md);
+    }
 
-out:
-    free(wmsg);
-    return;
+    m->txtlen += (int) url_decode_utf16(m->text + m->txtlen, msg);
+    if (addnl)
+    {
+        m->text[m->txtlen++] = L'\r';
+        m->text[m->txtlen++] = L'\n';
+    }
+    m->text[m->txtlen] = L'\0';
+
+    /* hash as we go so that the digest is ready when the message is displayed */
+    sha1_update(&m->md, m->text + start, (m->txtlen - start)*sizeof(m->text[0]));
 }
 
-/* Called when echo msg-window or echo msg-notify is received */
+/* Called when echo msg-window or echo msg-notify is received -- title is url-encoded */
 static void
 echo_msg_display(connection_t *c, time_t timestamp, const char *title, int type)
 {
-    WCHAR *wtitle = Widen(title);
+    WCHAR *wtitle = malloc((strlen(title) + 1)*sizeof(WCHAR));
 
     if (wtitle)
     {
+        wtitle[url_decode_utf16(wtitle, title)] = L'\0';
         c->echo_msg.title = wtitle;
     }
     else
@@ -294,46 +356,72 @@ echo_msg_display(connection_t *c, time_t timestamp, const char *title, int type)
     echo_msg_save(&c->echo_msg);
 }
 
+/*
+ * Decode the directive at the start of the url-encoded string s into
+ * buf. Returns a pointer to its argument in s (still encoded) or NULL
+ * if the directive has no argument.
+ */
+static const char *
+echo_msg_directive(const char *s, char *buf, size_t size)
+{
+    size_t i = 0;
+
+    while (*s)
+    {
+        char ch = (char) url_decode_char(&s);
+        if (ch == ' ')
+        {
+            buf[i] = '\0';
+            return s;
+        }
+        if (ch == '\0' || i == size - 1)
+        {
+            break;
+        }
+        buf[i++] = ch;
+    }
+    buf[i] = '\0';
+    return NULL;
+}
+
 void
 echo_msg_process(connection_t *c, time_t timestamp, const char *s)
 {
     wchar_t errmsg[256] = L"";
+    char directive[16];
 
-    char *msg = url_decode(s);
-    if (!msg)
-    {
-        WriteStatusLog(c, L"GUI> ", L"Error in url_decode of echo message", false);
-        return;
-    }
+    /* Only the directive is decoded here: the text is decoded as it is added */
+    const char *arg = echo_msg_directive(s, directive, sizeof(directive));
 
-    if (strbegins(msg, "msg "))
-    {
-        echo_msg_append(c, timestamp, msg + 4, true);
-    }
-    else if (streq(msg, "msg")) /* empty msg is treated as a new line */
+    if (streq(directive, "msg")) /* empty msg is treated as a new line */
     {
-        echo_msg_append(c, timestamp, msg+3, true);
+        echo_msg_append(c, timestamp, arg ? arg : "", true);
     }
-    else if (strbegins(msg, "msg-n "))
+    else if (streq(directive, "msg-n") && arg)
     {
-        echo_msg_append(c, timestamp, msg + 6, false);
+        echo_msg_append(c, timestamp, arg, false);
     }
-    else if (strbegins(msg, "msg-window "))
+    else if (streq(directive, "msg-window") && arg)
     {
-        echo_msg_display(c, timestamp, msg + 11, ECHO_MSG_WINDOW);
+        echo_msg_display(c, timestamp, arg, ECHO_MSG_WINDOW);
         echo_msg_clear(c, false);
     }
-    else if (strbegins(msg, "msg-notify "))
+    else if (streq(directive, "msg-notify") && arg)
     {
-        echo_msg_display(c, timestamp, msg + 11, ECHO_MSG_NOTIFY);
+        echo_msg_display(c, timestamp, arg, ECHO_MSG_NOTIFY);
         echo_msg_clear(c, false);
     }
     else
     {
-        _sntprintf_0(errmsg, L"WARNING: Unknown ECHO directive '%hs' ignored.", msg);
+        WCHAR *wmsg = malloc((strlen(s) + 1) * sizeof(WCHAR));
+        if (wmsg)
+        {
+            wmsg[url_decode_utf16(wmsg, s)] = L'\0';
+        }
+        _sntprintf_0(errmsg, L"WARNING: Unknown ECHO directive '%ls' ignored.", wmsg ? wmsg : L"");
         WriteStatusLog(c, L"GUI> ", errmsg, false);
+        free(wmsg);
     }
-    free(msg);
 }
 
 void
@@ -344,19 +432,13 @@ echo_msg_clear(connection_t *c, BOOL clear_history)
     free(c->echo_msg.title);
     c->echo_msg.text = NULL;
     c->echo_msg.txtlen = 0;
+    c->echo_msg.txtsize = 0;
     c->echo_msg.title = NULL;
 
     if (clear_history)
     {
         echo_msg_persist(c);
-        struct echo_msg_history *head = c->echo_msg.history;
-        struct echo_msg_history *next;
-        while (head)
-        {
-            next = head->next;
-            free(head);
-            head = next;
-        }
+        free(c->echo_msg.history);
         CLEAR(c->echo_msg);
     }
 }
@@ -23,21 +23,17 @@
 #define ECHO_H
 
 #include <wchar.h>
+#include "sha1.h"
+#include "echo_history.h"
 
 /* data structures and methods for handling echo msg */
-#define HASHLEN 20
-
-/* message finger print consists of a SHA1 hash and a timestamp */
-struct echo_msg_fp {
-    BYTE digest[HASHLEN];
-    time_t timestamp;
-};
-struct echo_msg_history;
 struct echo_msg {
     struct echo_msg_fp fp; /* keep this as the first element */
     wchar_t *title;
     wchar_t *text;
     int txtlen;
+    int txtsize;           /* allocated size of text in characters */
+    sha1_ctx md;           /* digest of text added so far */
     int type;
     struct echo_msg_history *history;
 };
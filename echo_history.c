@@ -0,0 +1,236 @@
+/*
+ *  OpenVPN-GUI -- A Windows GUI for OpenVPN.
+ *
+ *  Copyright (C) 2017 Selva Nair <selva.nair@gmail.com>
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program (see the file COPYING included with this
+ *  distribution); if not, write to the Free Software Foundation, Inc.,
+ *  59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+#ifdef HAVE_CONFIG_H
+#include <config.h>
+#endif
+
+#include <stdlib.h>
+#include <string.h>
+
+#include "echo_history.h"
+
+/* Hash slot where the search for a digest starts */
+static int
+echo_msg_hash(const unsigned char *digest)
+{
+    /* the digest is a SHA1 hash: any of its bytes are well distributed */
+    return (digest[0] | digest[1] << 8) & (ECHO_MSG_HISTORY_SLOTS - 1);
+}
+
+/* Return the slot holding the message with given digest or the empty slot where it belongs */
+static int
+echo_msg_slot(const struct echo_msg_history *hist, const unsigned char *digest)
+{
+    int i = echo_msg_hash(digest);
+
+    while (hist->slots[i] && memcmp(hist->fp[hist->slots[i] - 1].digest, digest, HASHLEN) != 0)
+    {
+        i = (i + 1) & (ECHO_MSG_HISTORY_SLOTS - 1);
+    }
+    return i;
+}
+
+/* find message with given digest in history -- returns its index or -1 */
+int
+echo_msg_history_find(const struct echo_msg_history *hist, const unsigned char *digest)
+{
+    if (!hist)
+    {
+        return -1;
+    }
+    return hist->slots[echo_msg_slot(hist, digest)] - 1;
+}
+
+/* Remove entry n from the list in order of use */
+static void
+echo_msg_history_unlink(struct echo_msg_history *hist, int n)
+{
+    if (hist->newer[n] >= 0)
+    {
+        hist->older[hist->newer[n]] = hist->older[n];
+    }
+    else
+    {
+        hist->newest = hist->older[n];
+    }
+    if (hist->older[n] >= 0)
+    {
+        hist->newer[hist->older[n]] = hist->newer[n];
+    }
+    else
+    {
+        hist->oldest = hist->newer[n];
+    }
+}
+
+/* Put entry n at the head of the list in order of use */
+static void
+echo_msg_history_link(struct echo_msg_history *hist, int n)
+{
+    hist->newer[n] = -1;
+    hist->older[n] = hist->newest;
+    if (hist->newest >= 0)
+    {
+        hist->newer[hist->newest] = n;
+    }
+    else
+    {
+        hist->oldest = n;
+    }
+    hist->newest = n;
+}
+
+/* Remove entry n from history. The last entry in fp[] is moved into its place. */
+void
+echo_msg_history_remove(struct echo_msg_history *hist, int n)
+{
+    const int mask = ECHO_MSG_HISTORY_SLOTS - 1;
+    int i = echo_msg_slot(hist, hist->fp[n].digest);
+
+    /* empty the slot and move back entries that probed past it */
+    hist->slots[i] = 0;
+    for (int j = (i + 1) & mask; hist->slots[j]; j = (j + 1) & mask)
+    {
+        int k = echo_msg_hash(hist->fp[hist->slots[j] - 1].digest);
+        if (((j - k) & mask) >= ((j - i) & mask))
+        {
+            hist->slots[i] = hist->slots[j];
+            hist->slots[j] = 0;
+            i = j;
+        }
+    }
+    echo_msg_history_unlink(hist, n);
+
+    int last = --hist->count;
+    if (n != last)
+    {
+        hist->slots[echo_msg_slot(hist, hist->fp[last].digest)] = n + 1;
+        hist->fp[n] = hist->fp[last];
+        hist->newer[n] = hist->newer[last];
+        hist->older[n] = hist->older[last];
+        if (hist->newer[n] >= 0)
+        {
+            hist->older[hist->newer[n]] = n;
+        }
+        else
+        {
+            hist->newest = n;
+        }
+        if (hist->older[n] >= 0)
+        {
+            hist->newer[hist->older[n]] = n;
+        }
+        else
+        {
+            hist->oldest = n;
+        }
+    }
+}
+
+/* Allocate an empty history. Returns NULL if out of memory. */
+struct echo_msg_history *
+echo_msg_history_new(void)
+{
+    struct echo_msg_history *hist = calloc(1, sizeof(*hist));
+    if (hist)
+    {
+        hist->newest = hist->oldest = -1;
+    }
+    return hist;
+}
+
+/*
+ * Add an item to message history as the most recently used. The least
+ * recently used item is evicted if the history is full.
+ */
+void
+echo_msg_history_add(struct echo_msg_history *hist, const struct echo_msg_fp *fp)
+{
+    if (hist->count == ECHO_MSG_HISTORY_MAX)
+    {
+        echo_msg_history_remove(hist, hist->oldest);
+    }
+
+    int n = hist->count++;
+    hist->fp[n] = *fp;
+    hist->slots[echo_msg_slot(hist, fp->digest)] = n + 1;
+    echo_msg_history_link(hist, n);
+}
+
+/* Drop items shown at or before cutoff, oldest first */
+void
+echo_msg_history_expire(struct echo_msg_history *hist, time_t cutoff)
+{
+    while (hist->oldest >= 0 && hist->fp[hist->oldest].timestamp <= cutoff)
+    {
+        echo_msg_history_remove(hist, hist->oldest);
+    }
+}
+
+/* Save message in history as the most recently used -- update if already present */
+void
+echo_msg_history_save(struct echo_msg_history *hist, const struct echo_msg_fp *fp)
+{
+    int n = echo_msg_history_find(hist, fp->digest);
+    if (n >= 0) /* update */
+    {
+        hist->fp[n].timestamp = fp->timestamp;
+        echo_msg_history_unlink(hist, n);
+        echo_msg_history_link(hist, n);
+    }
+    else     /* add */
+    {
+        echo_msg_history_add(hist, fp);
+    }
+}
+
+/* Copy the items to out, most recently shown first */
+size_t
+echo_msg_history_list(const struct echo_msg_history *hist, struct echo_msg_fp *out)
+{
+    size_t i = 0;
+
+    for (int n = hist->newest; n >= 0; n = hist->older[n])
+    {
+        out[i++] = hist->fp[n];
+    }
+    return i;
+}
+
+/* Add items as listed by echo_msg_history_list(), keeping their order */
+void
+echo_msg_history_restore(struct echo_msg_history *hist, const struct echo_msg_fp *items, size_t len)
+{
+    if (len > ECHO_MSG_HISTORY_MAX)
+    {
+        len = ECHO_MSG_HISTORY_MAX;
+    }
+
+    /* items are listed most recent first: add in reverse so that order is retained */
+    for (size_t i = len; i-- > 0; )
+    {
+        if (echo_msg_history_find(hist, items[i].digest) < 0)
+        {
+            echo_msg_history_add(hist, &items[i]);
+        }
+    }
+}
@@ -0,0 +1,99 @@
+/*
+ *  OpenVPN-GUI -- A Windows GUI for OpenVPN.
+ *
+ *  Copyright (C) 2017 Selva Nair <selva.nair@gmail.com>
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program (see the file COPYING included with this
+ *  distribution); if not, write to the Free Software Foundation, Inc.,
+ *  59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+#ifndef ECHO_HISTORY_H
+#define ECHO_HISTORY_H
+
+/*
+ * History of recently shown echo messages used to mute repeats. Only
+ * the C library is used.
+ */
+
+#include <stddef.h>
+#include <time.h>
+#include "sha1.h"
+
+#define HASHLEN SHA1_DIGEST_SIZE
+
+/* Max number of messages remembered in history and persisted */
+#define ECHO_MSG_HISTORY_MAX 100
+/* Number of hash slots in history -- a power of 2 and at least twice the max */
+#define ECHO_MSG_HISTORY_SLOTS 256
+
+/* message finger print consists of a SHA1 hash and a timestamp */
+struct echo_msg_fp {
+    unsigned char digest[HASHLEN];
+    time_t timestamp;
+};
+
+/*
+ * Fingerprints of recently shown messages. Entries are stored in fp[] and
+ * found by digest through an open-addressed hash table using linear probing.
+ * They are also linked in order of use, so that when the history is full
+ * the least recently shown message is evicted. Links and slots hold
+ * indices into fp[] -- slots store index + 1 so that 0 marks an empty slot.
+ */
+struct echo_msg_history {
+    struct echo_msg_fp fp[ECHO_MSG_HISTORY_MAX];
+    int newer[ECHO_MSG_HISTORY_MAX];    /* -1 for the newest */
+    int older[ECHO_MSG_HISTORY_MAX];    /* -1 for the oldest */
+    int slots[ECHO_MSG_HISTORY_SLOTS];
+    int newest;
+    int oldest;
+    int count;
+};
+
+/* Allocate an empty history. Returns NULL if out of memory. */
+struct echo_msg_history *echo_msg_history_new(void);
+
+/* Find message with given digest in history -- returns its index or -1 */
+int echo_msg_history_find(const struct echo_msg_history *hist, const unsigned char *digest);
+
+/*
+ * Add an item to message history as the most recently used. The least
+ * recently used item is evicted if the history is full. The digest
+ * must not be in history already.
+ */
+void echo_msg_history_add(struct echo_msg_history *hist, const struct echo_msg_fp *fp);
+
+/* Remove entry n from history. The last entry in fp[] is moved into its place. */
+void echo_msg_history_remove(struct echo_msg_history *hist, int n);
+
+/* Save message in history as the most recently used -- update if already present */
+void echo_msg_history_save(struct echo_msg_history *hist, const struct echo_msg_fp *fp);
+
+/* Drop items shown at or before cutoff, oldest first */
+void echo_msg_history_expire(struct echo_msg_history *hist, time_t cutoff);
+
+/*
+ * Copy the items to out, most recently shown first. out must have room
+ * for hist->count items. Returns the number of items copied.
+ */
+size_t echo_msg_history_list(const struct echo_msg_history *hist, struct echo_msg_fp *out);
+
+/*
+ * Add len items as listed by echo_msg_history_list(), keeping their order.
+ * Items already in history are skipped and at most ECHO_MSG_HISTORY_MAX
+ * are used.
+ */
+void echo_msg_history_restore(struct echo_msg_history *hist, const struct echo_msg_fp *items, size_t len);
+
+#endif /* ifndef ECHO_HISTORY_H */
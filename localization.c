@@ -31,6 +31,7 @@
 #include <stdio.h>
 #include <stdarg.h>
 #include <malloc.h>
+#include <stdlib.h>
 
 #include "main.h"
 #include "localization.h"
@@ -197,10 +198,104 @@ LocalizedTime(const time_t t, LPTSTR buf, size_t size)
     return LocalizedSystemTime(&st, buf, size);
 }
 
-static int
-LoadStringLang(UINT stringId, LANGID langId, PTSTR buffer, int bufferSize, va_list args)
+/*
+ * Cache of string resources resolved for a language, with the fallback to
+ * the default language already applied. Each entry holds a nul terminated
+ * copy of the string, or NULL if the string does not exist. Entries are
+ * never removed, so the strings remain valid for the lifetime of the process
+ * and can be used after the lock is released. The lock is needed as strings
+ * are loaded from the main thread and from all status threads.
+ */
+typedef struct {
+    DWORD key;                      /* langId << 16 | stringId, 0 if unused */
+    LPCWSTR str;
+} string_cache_entry_t;
+
+static struct {
+    string_cache_entry_t *slots;
+    size_t size;                    /* number of slots -- a power of 2 */
+    size_t count;                   /* number of slots in use */
+    SRWLOCK lock;
+} string_cache = { .lock = SRWLOCK_INIT };
+
+static size_t
+StringCacheSlot(DWORD key, size_t size)
+{
+    size_t i = (key * 2654435761u) >> 8;
+    return i & (size - 1);
+}
+
+/* Find the entry for key -- call with the lock held */
+static string_cache_entry_t *
+StringCacheFind(DWORD key)
+{
+    if (string_cache.count == 0)
+    {
+        return NULL;
+    }
+
+    for (size_t i = StringCacheSlot(key, string_cache.size); string_cache.slots[i].key;
+         i = (i + 1) & (string_cache.size - 1))
+    {
+        if (string_cache.slots[i].key == key)
+        {
+            return &string_cache.slots[i];
+        }
+    }
+    return NULL;
+}
+
+/*
+ * Add an entry, growing the table to keep the load below 1/2 -- call with
+ * the lock held exclusively. Returns false if out of memory.
+ */
+static BOOL
+StringCacheAdd(DWORD key, LPCWSTR str)
+{
+    if (2 * (string_cache.count + 1) > string_cache.size)
+    {
+        size_t size = string_cache.size ? 2 * string_cache.size : 256;
+        string_cache_entry_t *slots = calloc(size, sizeof(*slots));
+        if (!slots)
+        {
+            return FALSE;
+        }
+        for (size_t j = 0; j < string_cache.size; j++)
+        {
+            if (string_cache.slots[j].key)
+            {
+                size_t i = StringCacheSlot(string_cache.slots[j].key, size);
+                while (slots[i].key)
+                {
+                    i = (i + 1) & (size - 1);
+                }
+                slots[i] = string_cache.slots[j];
+            }
+        }
+        free(string_cache.slots);
+        string_cache.slots = slots;
+        string_cache.size = size;
+    }
+
+    size_t i = StringCacheSlot(key, string_cache.size);
+    while (string_cache.slots[i].key)
+    {
+        i = (i + 1) & (string_cache.size - 1);
+    }
+    string_cache.slots[i].key = key;
+    string_cache.slots[i].str = str;
+    string_cache.count++;
+    return TRUE;
+}
+
+/*
+ * Find a string in the resources of the given language. Returns a pointer
+ * to the length prefixed entry in the resource data, or NULL if not found.
+ */
+static const WCHAR *
+FindStringLang(UINT stringId, LANGID langId)
 {
-    PWCH entry;
+    const WCHAR *entry;
     PTSTR resBlockId = MAKEINTRESOURCE(stringId / 16 + 1);
     int resIndex = stringId & 15;
 
@@ -208,68 +303,187 @@ LoadStringLang(UINT stringId, LANGID langId, PTSTR buffer, int bufferSize, va_li
     HRSRC res = FindResourceLang(RT_STRING, resBlockId, langId);
     if (res == NULL)
     {
-        goto err;
+        return NULL;
     }
 
     /* get pointer to first entry in resource block */
-    entry = (PWCH) LoadResource(o.hInstance, res);
+    entry = (const WCHAR *) LoadResource(o.hInstance, res);
     if (entry == NULL)
     {
-        goto err;
+        return NULL;
     }
 
-    /* search for string in block */
-    for (int i = 0; i < 16; i++)
+    /* skip over the entries before this one */
+    for (int i = 0; i < resIndex; i++)
     {
-        /* skip over this entry */
-        if (i != resIndex)
-        {
-            entry += ((*entry) + 1);
-            continue;
-        }
+        entry += ((*entry) + 1);
+    }
 
-        /* string does not exist */
-        if (i == resIndex && *entry == 0)
-        {
-            break;
-        }
+    /* an empty entry means the string does not exist */
+    return (*entry == 0) ? NULL : entry;
+}
 
-        /* string found, copy it */
-        PTSTR formatStr = (PTSTR) malloc((*entry + 1) * sizeof(TCHAR));
-        if (formatStr == NULL)
+/*
+ * Return the string with the given id in the given language or the
+ * default language, or NULL if it does not exist. The result is shared
+ * and must not be modified or freed.
+ */
+static LPCWSTR
+LookupString(UINT stringId, LANGID langId)
+{
+    DWORD key = (DWORD) langId << 16 | (stringId & 0xffff);
+    string_cache_entry_t *e;
+    LPCWSTR str = NULL;
+
+    AcquireSRWLockShared(&string_cache.lock);
+    e = StringCacheFind(key);
+    if (e)
+    {
+        str = e->str;
+    }
+    ReleaseSRWLockShared(&string_cache.lock);
+    if (e)
+    {
+        return str;
+    }
+
+    const WCHAR *entry = FindStringLang(stringId, langId);
+    if (entry == NULL && langId != fallbackLangId)
+    {
+        entry = FindStringLang(stringId, fallbackLangId);
+    }
+
+    if (entry)
+    {
+        WCHAR *copy = malloc((*entry + 1) * sizeof(WCHAR));
+        if (copy == NULL)
         {
-            break;
+            return NULL; /* not cached -- try again next time */
         }
-        formatStr[*entry] = 0;
+        wcsncpy(copy, entry + 1, *entry);
+        copy[*entry] = 0;
+        str = copy;
+    }
 
-        wcsncpy(formatStr, entry + 1, *entry);
-        _vsntprintf(buffer, bufferSize, formatStr, args);
-        buffer[bufferSize - 1] = 0;
-        free(formatStr);
-        return _tcslen(buffer);
+    AcquireSRWLockExclusive(&string_cache.lock);
+    e = StringCacheFind(key);
+    if (e)
+    {
+        /* added by another thread meanwhile */
+        free((WCHAR *) str);
+        str = e->str;
     }
+    else if (!StringCacheAdd(key, str))
+    {
+        /* keep the copy allocated as the caller uses it */
+        PrintDebug(L"Out of memory caching string %u", stringId);
+    }
+    ReleaseSRWLockExclusive(&string_cache.lock);
+
+    return str;
+}
 
-err:
-    /* not found, try again with the default language */
-    if (langId != fallbackLangId)
+static int
+LoadStringLang(UINT stringId, LANGID langId, PTSTR buffer, int bufferSize, va_list args)
+{
+    LPCWSTR formatStr = LookupString(stringId, langId);
+    if (formatStr == NULL)
     {
-        return LoadStringLang(stringId, fallbackLangId, buffer, bufferSize, args);
+        return 0;
     }
 
-    return 0;
+    _vsntprintf(buffer, bufferSize, formatStr, args);
+    buffer[bufferSize - 1] = 0;
+    return _tcslen(buffer);
+}
+
+/*
+ * Strings are loaded concurrently from the main thread and the status
+ * threads: give each thread its own buffer for formatted strings. The
+ * buffers are kept in fiber local storage, which frees them on thread
+ * exit. Static TLS is not used as this code is also built into the PLAP
+ * dll, where it is not reliable.
+ */
+#define LOCALIZED_MSG_SIZE 512
+
+static INIT_ONCE msg_once = INIT_ONCE_STATIC_INIT;
+static DWORD msg_index = FLS_OUT_OF_INDEXES;
+
+static VOID WINAPI
+FreeMsgBuffer(PVOID buf)
+{
+    free(buf);
 }
 
+static BOOL CALLBACK
+AllocMsgIndex(UNUSED PINIT_ONCE once, UNUSED PVOID param, UNUSED PVOID *ctx)
+{
+    msg_index = FlsAlloc(FreeMsgBuffer);
+    return TRUE;
+}
+
+/* Get the buffer of the calling thread, or a shared one if out of resources */
+static PTSTR
+MsgBuffer(void)
+{
+    static TCHAR shared[LOCALIZED_MSG_SIZE];
+
+    InitOnceExecuteOnce(&msg_once, AllocMsgIndex, NULL, NULL);
+    if (msg_index == FLS_OUT_OF_INDEXES)
+    {
+        return shared;
+    }
+
+    PTSTR buf = FlsGetValue(msg_index);
+    if (!buf)
+    {
+        buf = malloc(LOCALIZED_MSG_SIZE * sizeof(TCHAR));
+        if (!buf || !FlsSetValue(msg_index, buf))
+        {
+            free(buf);
+            return shared;
+        }
+    }
+    return buf;
+}
+
+/*
+ * Free the string buffers of all threads. Must be called before the code
+ * is unloaded, as the buffers are otherwise freed from here on thread exit.
+ */
+void
+FreeLocalizedStringBuffers(void)
+{
+    if (msg_index != FLS_OUT_OF_INDEXES)
+    {
+        FlsFree(msg_index);
+        msg_index = FLS_OUT_OF_INDEXES;
+    }
+}
 
 static PTSTR
 __LoadLocalizedString(const UINT stringId, va_list args)
 {
-    static TCHAR msg[512];
+    PTSTR msg = MsgBuffer();
     msg[0] = 0;
-    LoadStringLang(stringId, GetGUILanguage(), msg, _countof(msg), args);
+    LoadStringLang(stringId, GetGUILanguage(), msg, LOCALIZED_MSG_SIZE, args);
     return msg;
 }
 
 
+/*
+ * Return a localized string without formatting it. The string is shared
+ * and remains valid for the lifetime of the process: it must not be modified
+ * or freed, but needs no copying. Returns an empty string if not found.
+ */
+LPCTSTR
+GetLocalizedString(const UINT stringId)
+{
+    LPCWSTR str = LookupString(stringId, GetGUILanguage());
+    return str ? str : L"";
+}
+
+
 PTSTR
 LoadLocalizedString(const UINT stringId, ...)
 {
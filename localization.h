@@ -26,10 +26,17 @@ int LocalizedTime(const time_t, LPTSTR, size_t);
 
 wchar_t *LocalizedFileTime(const FILETIME *ft);
 
+/* Returned string is valid until the next call from the same thread */
 PTSTR LoadLocalizedString(const UINT, ...);
 
+/* Returned string is shared and not formatted -- do not modify or free */
+LPCTSTR GetLocalizedString(const UINT);
+
 int LoadLocalizedStringBuf(PTSTR, const int, const UINT, ...);
 
+/* Free the per-thread buffers of LoadLocalizedString before unloading */
+void FreeLocalizedStringBuffers(void);
+
 void ShowLocalizedMsg(const UINT, ...);
 
 int ShowLocalizedMsgEx(const UINT, HANDLE, LPCTSTR, const UINT, ...);
@@ -538,7 +538,7 @@ ManagePersistent(HWND hwnd, UINT UNUSED msg, UINT_PTR id, DWORD UNUSED now)
                  * connect.
                  */
                 c->auto_connect = false;
-                c->state = detached; /* this is required to retain management-hold on re-attach */
+                SetConnState(c, detached); /* this is required to retain management-hold on re-attach */
                 StartOpenVPN(c); /* attach to the management i/f */
             }
         }
@@ -644,6 +644,19 @@ WindowProcedure(HWND hwnd, UINT message, WPARAM wParam, LPARAM lParam)
             OnNotifyTray(lParam); /* Manages message from tray */
             break;
 
+        case WM_INITMENUPOPUP:
+            OnInitMenuPopup((HMENU) wParam); /* Fill in connection menus on demand */
+            break;
+
+        case WM_OVPN_TRAYICON:
+            OnTrayIconRefresh(); /* Schedule a coalesced tray icon update */
+            break;
+
+        case WM_SYSCOLORCHANGE:
+        case WM_THEMECHANGED:
+            InvalidatePopupMenus(); /* Menu bitmaps follow colors and theme */
+            break;
+
         case WM_COPYDATA: /* custom messages with data from other processes */
             HandleCopyDataMessage((COPYDATASTRUCT *) lParam);
             return TRUE; /* lets the sender free copy_data */
@@ -724,6 +737,7 @@ WindowProcedure(HWND hwnd, UINT message, WPARAM wParam, LPARAM lParam)
         case WM_DESTROY:
             WTSUnRegisterSessionNotification(hwnd);
             StopAllOpenVPN(true);
+            DeleteLogTails();
             OnDestroyTray();    /* Remove Tray Icon and destroy menus */
             PostQuitMessage(0); /* Send a WM_QUIT to the message queue */
             break;
@@ -889,7 +903,7 @@ ShowSettingsDialog()
     psh.hwndParent = o.hWnd;
     psh.hInstance = o.hInstance;
     psh.hIcon = LoadLocalizedIcon(ID_ICO_APP);
-    psh.pszCaption = LoadLocalizedString(IDS_SETTINGS_CAPTION);
+    psh.pszCaption = GetLocalizedString(IDS_SETTINGS_CAPTION);
     psh.nPages = page_number;
     psh.nStartPage = 0;
     psh.ppsp = (LPCPROPSHEETPAGE) &psp;
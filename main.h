@@ -61,6 +61,8 @@
 #define WM_OVPN_ECHOMSG        (WM_APP + 22)
 #define WM_OVPN_STATE          (WM_APP + 23)
 #define WM_OVPN_DETACH         (WM_APP + 24)
+#define WM_OVPN_TRAYICON       (WM_APP + 25)
+#define WM_OVPN_LOGLINE        (WM_APP + 26)
 
 #define MSGF_OVPN_WAIT         (MSGF_USER + 1)
 
@@ -29,8 +29,10 @@
 
 #include "options.h"
 #include "manage.h"
+#include "mgmt_proto.h"
 #include "main.h"
 #include "misc.h"
+#include "openvpn-gui-res.h"
 
 extern options_t o;
 
@@ -41,6 +43,12 @@ static mgmt_msg_func rtmsg_handler[mgmt_rtmsg_type_max];
  */
 static const time_t max_connect_time = 15;
 
+/*
+ * Number of milliseconds to wait after the greeting before the
+ * management interface is considered ready for input
+ */
+static const UINT ready_delay = 100;
+
 /*
  * Initialize the real-time notification handlers
  */
@@ -52,6 +60,8 @@ InitManagement(const mgmt_rtmsg_handler *handler)
     {
         rtmsg_handler[handler[i].type] = handler[i].handler;
     }
+
+    mgmt_rtmsg_init();
 }
 
 /*
@@ -88,30 +98,61 @@ OpenManagement(connection_t *c)
 
 
 /*
- * Try to send a queued management command to OpenVPN
+ * Try to send queued management commands to OpenVPN. All commands not yet
+ * sent are written with a single send() call; responses are still matched
+ * to commands in the order they were queued.
  */
 static void
 SendCommand(connection_t *c)
 {
+    char buf[1024];
+    const char *data;
+    size_t len;
     int res;
-    mgmt_cmd_t *cmd = c->manage.cmd_queue;
-    if (cmd == NULL || cmd->size == 0)
+
+    len = mgmt_cmd_pending(&c->manage.cmds, c->manage.connected > 1, buf, sizeof(buf), &data);
+    if (len == 0)
     {
         return;
     }
 
-    res = send(c->manage.sk, cmd->command, cmd->size, 0);
+    res = send(c->manage.sk, data, (int) len, 0);
+    /* Wipe buffer as it may contain passwords */
+    if (data == buf)
+    {
+        SecureZeroMemory(buf, len);
+    }
     if (res < 1)
     {
         return;
     }
 
-    if (res != cmd->size)
+    mgmt_cmd_sent(&c->manage.cmds, res);
+}
+
+
+/*
+ * Arrange for queued commands to be sent once control returns to the
+ * message loop, so that commands issued together go out in one send().
+ */
+static void
+ScheduleSendCommand(connection_t *c)
+{
+    if (c->manage.send_pending)
     {
-        memmove(cmd->command, cmd->command + res, cmd->size - res);
+        return;
     }
 
-    cmd->size -= res;
+    if (c->hwndStatus
+        && PostMessage(c->hwndStatus, WM_MANAGEMENT, (WPARAM) c->manage.sk,
+                       WSAMAKESELECTREPLY(FD_WRITE, 0)))
+    {
+        c->manage.send_pending = TRUE;
+    }
+    else
+    {
+        SendCommand(c);
+    }
 }
 
 
@@ -121,98 +162,126 @@ SendCommand(connection_t *c)
 BOOL
 ManagementCommand(connection_t *c, char *command, mgmt_msg_func handler, mgmt_cmd_type type)
 {
-    mgmt_cmd_t *cmd = calloc(1, sizeof(*cmd));
-    if (cmd == NULL)
+    if (!mgmt_cmd_add(&c->manage.cmds, command, handler, type, FALSE, c->manage.connected > 1))
     {
         return FALSE;
     }
 
-    cmd->size = strlen(command) + 1;
-    cmd->command = malloc(cmd->size);
-    if (cmd->command == NULL)
-    {
-        free(cmd);
-        return FALSE;
-    }
-    memcpy(cmd->command, command, cmd->size);
-    *(cmd->command + cmd->size - 1) = '\n';
+    ScheduleSendCommand(c);
 
-    cmd->handler = handler;
-    cmd->type = type;
+    return TRUE;
+}
 
-    if (c->manage.cmd_queue)
-    {
-        cmd->next = c->manage.cmd_queue;
-        cmd->prev = c->manage.cmd_queue->prev;
-        cmd->next->prev = cmd->prev->next = cmd;
-    }
-    else
-    {
-        cmd->next = cmd->prev = cmd;
-        c->manage.cmd_queue = cmd;
-    }
 
-    if (c->manage.cmd_queue == cmd)
+/*
+ * Read all available management interface output into the receive buffer.
+ * Returns the number of bytes read.
+ */
+static size_t
+RecvManagement(connection_t *c)
+{
+    mgmt_rbuf_t *rb = &c->manage.rbuf;
+    ULONG data_size;
+    size_t total = 0;
+
+    while (c->manage.sk != INVALID_SOCKET
+           && ioctlsocket(c->manage.sk, FIONREAD, &data_size) == 0
+           && data_size > 0)
     {
-        SendCommand(c);
+        size_t avail;
+        char *tail = mgmt_rbuf_reserve(rb, data_size, &avail);
+        if (avail == 0)
+        {
+            break;
+        }
+
+        int res = recv(c->manage.sk, tail, (int) min(avail, (size_t) data_size), 0);
+        if (res < 1)
+        {
+            break;
+        }
+        mgmt_rbuf_commit(rb, res);
+        total += res;
     }
 
-    return TRUE;
+    return total;
 }
 
 
 /*
- * Remove a command from a connection's command queue
+ * Split the receive buffer into lines and dispatch them. Lines are parsed
+ * in place and consumed from the buffer before their handler is called:
+ * handlers may open modal dialogs that re-enter OnManagement, which then
+ * continues with the next line. Incomplete lines are left in the buffer.
  */
-static BOOL
-UnqueueCommand(connection_t *c)
+static void
+ProcessManagementLines(connection_t *c)
 {
-    mgmt_cmd_t *cmd = c->manage.cmd_queue;
-    if (!cmd)
-    {
-        return FALSE;
-    }
+    mgmt_rbuf_t *rb = &c->manage.rbuf;
+    int passwd_request;
+    char *line;
 
-    /* Wipe command as it may contain passwords */
-    memset(cmd->command, 'x', cmd->size);
+    mgmt_rbuf_begin(rb);
 
-    if (cmd->type == combined)
+    while (c->manage.sk != INVALID_SOCKET
+           && (line = mgmt_rbuf_getline(rb, &passwd_request)) != NULL)
     {
-        cmd->type = regular;
-        return TRUE;
-    }
+        /* Reply to a management password request */
+        if (passwd_request && c->manage.password && *c->manage.password)
+        {
+            mgmt_cmd_add(&c->manage.cmds, c->manage.password, NULL, regular, TRUE,
+                         c->manage.connected > 1);
+            FreeManagementPassword(c);
+            SendCommand(c);
 
-    if (cmd->next == cmd)
-    {
-        c->manage.cmd_queue = NULL;
-    }
-    else
-    {
-        cmd->prev->next = cmd->next;
-        cmd->next->prev = cmd->prev;
-        c->manage.cmd_queue = cmd->next;
-        SendCommand(c);
-    }
+            continue;
+        }
 
-    free(cmd->command);
-    free(cmd);
+        if (passwd_request)
+        {
+            /* either we don't have a password or we used it and didn't match */
+            MsgToEventLog(EVENTLOG_WARNING_TYPE, L"%ls: management password mismatch",
+                          c->config_name);
+            SetConnState(c, disconnecting);
+            CloseManagement(c);
+            rtmsg_handler[stop_](c, "");
 
-    return TRUE;
+            continue;
+        }
+
+        /* Handle regular management interface output */
+        char *msg;
+        if (mgmt_dispatch_line(c, &c->manage.cmds, rtmsg_handler, line, &msg) == ready_)
+        {
+            /* The interface may not accept input right after the greeting:
+             * confirm readiness from a timer instead of blocking here.
+             * Commands queued meanwhile, including those of the ready
+             * handler, are held until then.
+             */
+            if (rtmsg_handler[ready_])
+            {
+                rtmsg_handler[ready_](c, msg);
+            }
+            if (c->manage.connected == 1)
+            {
+                SetTimer(c->hwndStatus, IDT_MGMT_READY_TIMER, ready_delay, NULL);
+            }
+        }
+    }
+
+    mgmt_rbuf_end(rb, c->manage.sk == INVALID_SOCKET);
 }
 
 
 /*
- * Handle management socket events asynchronously
+ * Handle management socket events asynchronously. The connection is that
+ * of the status window the event was delivered to; events for a socket
+ * that has since been closed are ignored.
  */
 void
-OnManagement(SOCKET sk, LPARAM lParam)
+OnManagement(connection_t *c, SOCKET sk, LPARAM lParam)
 {
-    int res;
-    char *data;
-    ULONG data_size, offset;
-
-    connection_t *c = GetConnByManagement(sk);
-    if (c == NULL)
+    if (c == NULL || c->manage.sk != sk)
     {
         return;
     }
@@ -254,230 +323,14 @@ OnManagement(SOCKET sk, LPARAM lParam)
             break;
 
         case FD_READ:
-            if (ioctlsocket(c->manage.sk, FIONREAD, &data_size) != 0
-                ||  data_size == 0)
-            {
-                return;
-            }
-
-            data = malloc(c->manage.saved_size + data_size);
-            if (data == NULL)
-            {
-                return;
-            }
-
-            res = recv(c->manage.sk, data + c->manage.saved_size, data_size, 0);
-            if (res != (int) data_size)
-            {
-                free(data);
-                return;
-            }
-
-            /* Copy previously saved management data */
-            if (c->manage.saved_size)
+            while (RecvManagement(c) > 0)
             {
-                memcpy(data, c->manage.saved_data, c->manage.saved_size);
-                data_size += c->manage.saved_size;
-                free(c->manage.saved_data);
-                c->manage.saved_data = NULL;
-                c->manage.saved_size = 0;
+                ProcessManagementLines(c);
             }
-
-            offset = 0;
-            while (offset < data_size)
-            {
-                char *pos;
-                char *line = data + offset;
-                size_t line_size = data_size - offset;
-                BOOL passwd_request = false;
-                const char *passwd_prompt = "ENTER PASSWORD:";
-
-                if (line_size >= strlen(passwd_prompt)
-                    && memcmp(line, passwd_prompt, strlen(passwd_prompt)) == 0)
-                {
-                    pos = memchr(line, ':', line_size);
-                    passwd_request = true;
-                }
-                else
-                {
-                    pos = memchr(line, '\n', line_size);
-                }
-
-                if (pos == NULL)
-                {
-                    c->manage.saved_data = malloc(line_size);
-                    if (c->manage.saved_data)
-                    {
-                        c->manage.saved_size = line_size;
-                        memcpy(c->manage.saved_data, line, c->manage.saved_size);
-                    }
-                    break;
-                }
-
-                offset += (pos - line) + 1;
-
-                /* Reply to a management password request */
-                if (*c->manage.password && passwd_request)
-                {
-                    ManagementCommand(c, c->manage.password, NULL, regular);
-                    SecureZeroMemory(c->manage.password, sizeof(c->manage.password));
-
-                    continue;
-                }
-
-                if (!*c->manage.password && passwd_request)
-                {
-                    /* either we don't have a password or we used it and didn't match */
-                    MsgToEventLog(EVENTLOG_WARNING_TYPE, L"%ls: management password mismatch",
-                                  c->config_name);
-                    c->state = disconnecting;
-                    CloseManagement(c);
-                    rtmsg_handler[stop_](c, "");
-
-                    continue;
-                }
-
-                /* Handle regular management interface output */
-                line[pos - line - 1] = '\0';
-                if (line[0] == '>')
-                {
-                    /* Real time notifications */
-                    pos = line + 1;
-                    if (strncmp(pos, "LOG:", 4) == 0)
-                    {
-                        if (rtmsg_handler[log_])
-                        {
-                            rtmsg_handler[log_](c, pos + 4);
-                        }
-                    }
-                    else if (strncmp(pos, "STATE:", 6) == 0)
-                    {
-                        if (rtmsg_handler[state_])
-                        {
-                            rtmsg_handler[state_](c, pos + 6);
-                        }
-                    }
-                    else if (strncmp(pos, "HOLD:", 5) == 0)
-                    {
-                        if (rtmsg_handler[hold_])
-                        {
-                            rtmsg_handler[hold_](c, pos + 5);
-                        }
-                    }
-                    else if (strncmp(pos, "PASSWORD:", 9) == 0)
-                    {
-                        if (rtmsg_handler[password_])
-                        {
-                            rtmsg_handler[password_](c, pos + 9);
-                        }
-                    }
-                    else if (strncmp(pos, "PROXY:", 6) == 0)
-                    {
-                        if (rtmsg_handler[proxy_])
-                        {
-                            rtmsg_handler[proxy_](c, pos + 6);
-                        }
-                    }
-                    else if (strncmp(pos, "INFO:", 5) == 0)
-                    {
-                        /* delay until management interface accepts input */
-                        /* use real sleep here, since WM_MANAGEMENT might arrive before management is ready */
-                        Sleep(100);
-                        c->manage.connected = 2;
-                        if (rtmsg_handler[ready_])
-                        {
-                            rtmsg_handler[ready_](c, pos + 5);
-                        }
-                    }
-                    else if (strncmp(pos, "NEED-OK:", 8) == 0)
-                    {
-                        if (rtmsg_handler[needok_])
-                        {
-                            rtmsg_handler[needok_](c, pos + 8);
-                        }
-                    }
-                    else if (strncmp(pos, "NEED-STR:", 9) == 0)
-                    {
-                        if (rtmsg_handler[needstr_])
-                        {
-                            rtmsg_handler[needstr_](c, pos + 9);
-                        }
-                    }
-                    else if (strncmp(pos, "ECHO:", 5) == 0)
-                    {
-                        if (rtmsg_handler[echo_])
-                        {
-                            rtmsg_handler[echo_](c, pos + 5);
-                        }
-                    }
-                    else if (strncmp(pos, "BYTECOUNT:", 10) == 0)
-                    {
-                        if (rtmsg_handler[bytecount_])
-                        {
-                            rtmsg_handler[bytecount_](c, pos + 10);
-                        }
-                    }
-                    else if (strncmp(pos, "INFOMSG:", 8) == 0)
-                    {
-                        if (rtmsg_handler[infomsg_])
-                        {
-                            rtmsg_handler[infomsg_](c, pos + 8);
-                        }
-                    }
-                    else if (strncmp(pos, "PKCS11ID", 8) == 0
-                             && c->manage.cmd_queue)
-                    {
-                        /* This is not a real-time message, but unfortunately implemented
-                         * in the core as one. Work around by handling the response here.
-                         */
-                        mgmt_cmd_t *cmd = c->manage.cmd_queue;
-                        if (cmd->handler)
-                        {
-                            cmd->handler(c, line);
-                        }
-                        UnqueueCommand(c);
-                    }
-                }
-                else if (c->manage.cmd_queue)
-                {
-                    /* Response to commands */
-                    mgmt_cmd_t *cmd = c->manage.cmd_queue;
-                    if (strncmp(line, "SUCCESS:", 8) == 0)
-                    {
-                        if (cmd->handler)
-                        {
-                            cmd->handler(c, line + 9);
-                        }
-                        UnqueueCommand(c);
-                    }
-                    else if (strncmp(line, "ERROR:", 6) == 0)
-                    {
-                        /* Response sent to management is not processed. Log an error in status window  */
-                        char buf[256];
-                        _snprintf_0(buf, "%lld,N,Previous command sent to management failed: %s",
-                                    (long long)time(NULL), line)
-                        rtmsg_handler[log_](c, buf);
-
-                        if (cmd->handler)
-                        {
-                            cmd->handler(c, NULL);
-                        }
-                        UnqueueCommand(c);
-                    }
-                    else if (strcmp(line, "END") == 0)
-                    {
-                        UnqueueCommand(c);
-                    }
-                    else if (cmd->handler)
-                    {
-                        cmd->handler(c, line);
-                    }
-                }
-            }
-            free(data);
             break;
 
         case FD_WRITE:
+            c->manage.send_pending = FALSE;
             SendCommand(c);
             break;
 
@@ -491,23 +344,68 @@ OnManagement(SOCKET sk, LPARAM lParam)
     }
 }
 
+/*
+ * Called when the readiness timer set on receiving the greeting expires:
+ * mark the management interface ready and send the held commands.
+ */
+void
+OnManagementReady(connection_t *c)
+{
+    KillTimer(c->hwndStatus, IDT_MGMT_READY_TIMER);
+    if (c->manage.connected != 1)
+    {
+        return;
+    }
+
+    c->manage.connected = 2;
+    SendCommand(c);
+}
+
+/*
+ * Allocate a cleared buffer of MGMT_PASSWORD_SIZE bytes for the management
+ * password. The password is kept only until it has been sent, so this memory
+ * is not held by idle connections. Returns NULL if out of memory.
+ */
+char *
+AllocManagementPassword(connection_t *c)
+{
+    if (c->manage.password)
+    {
+        SecureZeroMemory(c->manage.password, MGMT_PASSWORD_SIZE);
+    }
+    else
+    {
+        c->manage.password = calloc(1, MGMT_PASSWORD_SIZE);
+    }
+    return c->manage.password;
+}
+
+/*
+ * Wipe and free the management password
+ */
+void
+FreeManagementPassword(connection_t *c)
+{
+    if (c->manage.password)
+    {
+        SecureZeroMemory(c->manage.password, MGMT_PASSWORD_SIZE);
+        free(c->manage.password);
+        c->manage.password = NULL;
+    }
+}
+
 void
 CloseManagement(connection_t *c)
 {
     if (c->manage.sk != INVALID_SOCKET)
     {
-        if (c->manage.saved_size)
-        {
-            free(c->manage.saved_data);
-            c->manage.saved_data = NULL;
-            c->manage.saved_size = 0;
-        }
+        KillTimer(c->hwndStatus, IDT_MGMT_READY_TIMER);
+        mgmt_rbuf_reset(&c->manage.rbuf);
         closesocket(c->manage.sk);
         c->manage.sk = INVALID_SOCKET;
         c->manage.connected = 0;
-        while (UnqueueCommand(c))
-        {
-        }
+        c->manage.send_pending = FALSE;
+        mgmt_cmd_clear(&c->manage.cmds);
         WSACleanup();
     }
 }
@@ -24,44 +24,15 @@
 
 #include <winsock2.h>
 
-typedef enum {
-    ready_,
-    stop_,
-    bytecount_,
-    echo_,
-    hold_,
-    log_,
-    password_,
-    proxy_,
-    state_,
-    needok_,
-    needstr_,
-    pkcs11_id_count_,
-    infomsg_,
-    timeout_,
-    mgmt_rtmsg_type_max
-} mgmt_rtmsg_type;
+#include "mgmt_proto.h"
 
-typedef enum {
-    regular,
-    combined
-} mgmt_cmd_type;
-
-typedef void (*mgmt_msg_func)(connection_t *, char *);
+#define MGMT_PASSWORD_SIZE 4096   /* match with largest possible passwd in openvpn.exe */
 
 typedef struct {
     mgmt_rtmsg_type type;
     mgmt_msg_func handler;
 } mgmt_rtmsg_handler;
 
-typedef struct mgmt_cmd {
-    struct mgmt_cmd *prev, *next;
-    char *command;
-    int size;
-    mgmt_msg_func handler;
-    mgmt_cmd_type type;
-} mgmt_cmd_t;
-
 
 void InitManagement(const mgmt_rtmsg_handler *handler);
 
@@ -69,8 +40,14 @@ BOOL OpenManagement(connection_t *);
 
 BOOL ManagementCommand(connection_t *, char *, mgmt_msg_func, mgmt_cmd_type);
 
-void OnManagement(SOCKET, LPARAM);
+void OnManagement(connection_t *, SOCKET, LPARAM);
+
+void OnManagementReady(connection_t *);
 
 void CloseManagement(connection_t *);
 
+char *AllocManagementPassword(connection_t *);
+
+void FreeManagementPassword(connection_t *);
+
 #endif /* ifndef MANAGE_H */
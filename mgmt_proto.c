@@ -0,0 +1,678 @@
+/*
+ *  OpenVPN-GUI -- A Windows GUI for OpenVPN.
+ *
+ *  Copyright (C) 2010 Heiko Hund <heikoh@users.sf.net>
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program (see the file COPYING included with this
+ *  distribution); if not, write to the Free Software Foundation, Inc.,
+ *  59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+#ifdef HAVE_CONFIG_H
+#include <config.h>
+#endif
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "mgmt_proto.h"
+
+/*
+ * Initial size and growth limits of the receive buffer
+ */
+#define MGMT_RBUF_MIN_SIZE  4096
+#define MGMT_RBUF_IDLE_MAX  (64*1024)  /* release larger buffers once drained */
+
+/*
+ * Prefixes of real-time notifications, grouped by first character.
+ * Messages are looked up via rtmsg_index which maps the first character
+ * to the first table entry starting with it.
+ */
+#define RTMSG(prefix, type) { prefix, sizeof(prefix) - 1, type }
+static const struct {
+    const char *prefix;
+    size_t len;
+    mgmt_rtmsg_type type;
+} rtmsg_prefix[] = {
+    RTMSG("BYTECOUNT:", bytecount_),
+    RTMSG("ECHO:", echo_),
+    RTMSG("HOLD:", hold_),
+    RTMSG("INFO:", ready_),
+    RTMSG("INFOMSG:", infomsg_),
+    RTMSG("LOG:", log_),
+    RTMSG("NEED-OK:", needok_),
+    RTMSG("NEED-STR:", needstr_),
+    RTMSG("PASSWORD:", password_),
+    RTMSG("PKCS11ID", pkcs11_id_count_),
+    RTMSG("PROXY:", proxy_),
+    RTMSG("STATE:", state_),
+};
+#undef RTMSG
+
+#define RTMSG_COUNT ((int) (sizeof(rtmsg_prefix) / sizeof(rtmsg_prefix[0])))
+
+static unsigned char rtmsg_index[26]; /* 1 + index into rtmsg_prefix, 0 if none */
+
+/*
+ * Wipe memory in a way the compiler cannot optimize away
+ */
+void
+mgmt_wipe(void *p, size_t n)
+{
+    volatile unsigned char *v = p;
+    while (n--)
+    {
+        *v++ = 0;
+    }
+}
+
+/*
+ * Build the index for looking up real-time notifications
+ */
+void
+mgmt_rtmsg_init(void)
+{
+    for (int i = RTMSG_COUNT - 1; i >= 0; --i)
+    {
+        rtmsg_index[rtmsg_prefix[i].prefix[0] - 'A'] = i + 1;
+    }
+}
+
+/*
+ * Find the type of a real-time notification. Returns mgmt_rtmsg_type_max
+ * if the message is not recognized, else sets *len to the prefix length.
+ */
+mgmt_rtmsg_type
+mgmt_rtmsg_lookup(const char *msg, size_t *len)
+{
+    if (msg[0] < 'A' || msg[0] > 'Z')
+    {
+        return mgmt_rtmsg_type_max;
+    }
+
+    for (int i = rtmsg_index[msg[0] - 'A'] - 1;
+         i >= 0 && i < RTMSG_COUNT && rtmsg_prefix[i].prefix[0] == msg[0];
+         ++i)
+    {
+        if (strncmp(msg, rtmsg_prefix[i].prefix, rtmsg_prefix[i].len) == 0)
+        {
+            *len = rtmsg_prefix[i].len;
+            return rtmsg_prefix[i].type;
+        }
+    }
+
+    return mgmt_rtmsg_type_max;
+}
+
+/*
+ * Replace the data of a busy buffer with a new one of the given size
+ * holding only the unprocessed bytes. The old data may still be referenced
+ * by lines being dispatched: it is freed when processing unwinds.
+ * Returns 0 if out of memory.
+ */
+static int
+rbuf_replace(mgmt_rbuf_t *rb, size_t size)
+{
+    mgmt_rbuf_retired_t *old = malloc(sizeof(*old));
+    char *data = malloc(size);
+
+    if (old == NULL || data == NULL)
+    {
+        free(old);
+        free(data);
+        return 0;
+    }
+    memcpy(data, rb->data + rb->start, rb->len);
+
+    old->data = rb->data;
+    old->next = rb->retired;
+    rb->retired = old;
+
+    rb->data = data;
+    rb->size = size;
+    rb->start = 0;
+    return 1;
+}
+
+/*
+ * Free the buffers replaced while lines were being processed
+ */
+static void
+rbuf_free_retired(mgmt_rbuf_t *rb)
+{
+    while (rb->retired)
+    {
+        mgmt_rbuf_retired_t *next = rb->retired->next;
+        free(rb->retired->data);
+        free(rb->retired);
+        rb->retired = next;
+    }
+}
+
+/*
+ * Make room for at least 'need' bytes at the tail of the receive buffer.
+ * Unprocessed data is moved to the front and the buffer grown geometrically
+ * as required. While lines are being processed the data is copied to a new
+ * buffer instead, leaving the lines being dispatched in place.
+ * Returns a pointer to the tail and sets *avail to the room available there.
+ */
+char *
+mgmt_rbuf_reserve(mgmt_rbuf_t *rb, size_t need, size_t *avail)
+{
+    *avail = rb->size - rb->start - rb->len;
+
+    if (*avail >= need)
+    {
+        return rb->data + rb->start + rb->len;
+    }
+
+    if (rb->busy)
+    {
+        size_t size = rb->size ? rb->size : MGMT_RBUF_MIN_SIZE;
+        while (size - rb->len < need)
+        {
+            size *= 2;
+        }
+        if (rbuf_replace(rb, size))
+        {
+            *avail = rb->size - rb->len;
+        }
+        return rb->data + rb->start + rb->len;
+    }
+
+    if (rb->start > 0)
+    {
+        memmove(rb->data, rb->data + rb->start, rb->len);
+        rb->start = 0;
+        *avail = rb->size - rb->len;
+        if (*avail >= need)
+        {
+            return rb->data + rb->len;
+        }
+    }
+
+    size_t size = rb->size ? rb->size : MGMT_RBUF_MIN_SIZE;
+    while (size - rb->len < need)
+    {
+        size *= 2;
+    }
+
+    char *data = realloc(rb->data, size);
+    if (data != NULL)
+    {
+        rb->data = data;
+        rb->size = size;
+        *avail = rb->size - rb->len;
+    }
+
+    return rb->data + rb->len;
+}
+
+/*
+ * Add n bytes written at the tail to the buffered data
+ */
+void
+mgmt_rbuf_commit(mgmt_rbuf_t *rb, size_t n)
+{
+    rb->len += n;
+}
+
+/*
+ * Remove the next complete line from the receive buffer and return it
+ * NUL terminated with any trailing CR stripped. The line stays valid
+ * until the buffer is reset or, outside of mgmt_rbuf_begin/end, more data
+ * is reserved. A management password prompt, which is not terminated by
+ * a newline, is returned as a line with *passwd_prompt set.
+ * Returns NULL if no complete line is available.
+ */
+char *
+mgmt_rbuf_getline(mgmt_rbuf_t *rb, int *passwd_prompt)
+{
+    static const char prompt[] = "ENTER PASSWORD:";
+    const size_t prompt_len = sizeof(prompt) - 1;
+    char *line = rb->data + rb->start;
+    char *pos;
+
+    if (rb->len == 0)
+    {
+        return NULL;
+    }
+
+    *passwd_prompt = rb->len >= prompt_len && memcmp(line, prompt, prompt_len) == 0;
+    if (*passwd_prompt)
+    {
+        pos = line + prompt_len - 1;
+    }
+    else
+    {
+        pos = memchr(line, '\n', rb->len);
+        if (pos == NULL)
+        {
+            return NULL; /* incomplete line */
+        }
+    }
+
+    rb->start += (pos - line) + 1;
+    rb->len -= (pos - line) + 1;
+
+    *pos = '\0';
+    if (pos > line && pos[-1] == '\r')
+    {
+        pos[-1] = '\0';
+    }
+
+    return line;
+}
+
+/*
+ * Mark the start of line processing: the buffer is not moved until the
+ * matching mgmt_rbuf_end().
+ */
+void
+mgmt_rbuf_begin(mgmt_rbuf_t *rb)
+{
+    rb->busy++;
+}
+
+/*
+ * Mark the end of line processing. When the outermost level unwinds the
+ * buffer is released if requested or if it is large and empty.
+ */
+void
+mgmt_rbuf_end(mgmt_rbuf_t *rb, int release)
+{
+    if (--rb->busy)
+    {
+        return;
+    }
+    rbuf_free_retired(rb);
+
+    if (release || (rb->len == 0 && rb->size > MGMT_RBUF_IDLE_MAX))
+    {
+        mgmt_rbuf_reset(rb);
+    }
+    else if (rb->len == 0)
+    {
+        rb->start = 0;
+    }
+}
+
+/*
+ * Discard all buffered data and free the buffer unless lines are being
+ * processed from it. A busy buffer is only emptied and gets released when
+ * processing unwinds.
+ */
+void
+mgmt_rbuf_reset(mgmt_rbuf_t *rb)
+{
+    rb->start = 0;
+    rb->len = 0;
+    if (!rb->busy)
+    {
+        rbuf_free_retired(rb);
+        free(rb->data);
+        rb->data = NULL;
+        rb->size = 0;
+    }
+}
+
+/*
+ * Get a command node with storage for len bytes, reusing a previously
+ * released one if available. Short commands are stored inline.
+ */
+static mgmt_cmd_t *
+alloc_cmd(mgmt_cmd_queue_t *q, size_t len)
+{
+    mgmt_cmd_t *cmd = q->free;
+
+    if (cmd)
+    {
+        q->free = cmd->next;
+        q->stats.pooled--;
+        q->stats.reused++;
+    }
+    else
+    {
+        cmd = malloc(sizeof(*cmd));
+        if (cmd == NULL)
+        {
+            return NULL;
+        }
+        q->stats.allocs++;
+    }
+    cmd->prev = cmd->next = NULL;
+
+    if (len <= sizeof(cmd->inline_buf))
+    {
+        cmd->command = cmd->inline_buf;
+    }
+    else
+    {
+        cmd->command = malloc(len);
+        if (cmd->command == NULL)
+        {
+            free(cmd);
+            return NULL;
+        }
+        q->stats.long_cmds++;
+    }
+    cmd->size = cmd->len = (int) len;
+
+    return cmd;
+}
+
+/*
+ * Wipe a command, as it may contain passwords, and return it to the
+ * free list of the queue.
+ */
+static void
+release_cmd(mgmt_cmd_queue_t *q, mgmt_cmd_t *cmd)
+{
+    mgmt_wipe(cmd->command, cmd->len);
+    if (cmd->command != cmd->inline_buf)
+    {
+        free(cmd->command);
+    }
+    cmd->command = NULL;
+
+    if (q->stats.pooled < MGMT_CMD_POOL_MAX)
+    {
+        cmd->next = q->free;
+        q->free = cmd;
+        q->stats.pooled++;
+    }
+    else
+    {
+        free(cmd);
+    }
+}
+
+/*
+ * Append a command to the queue. Early commands are placed ahead of
+ * commands held back while the interface is not ready.
+ * Returns 1 on success, 0 if out of memory.
+ */
+int
+mgmt_cmd_add(mgmt_cmd_queue_t *q, const char *command, mgmt_msg_func handler,
+             mgmt_cmd_type type, int early, int ready)
+{
+    mgmt_cmd_t *cmd = alloc_cmd(q, strlen(command) + 1);
+    if (cmd == NULL)
+    {
+        return 0;
+    }
+
+    memcpy(cmd->command, command, cmd->len - 1);
+    cmd->command[cmd->len - 1] = '\n';
+
+    cmd->handler = handler;
+    cmd->type = type;
+    cmd->early = early;
+
+    if (q->head)
+    {
+        /* append, or insert ahead of the first command still held back */
+        mgmt_cmd_t *next = q->head;
+        if (early && !ready)
+        {
+            while (next->early && next->next != q->head)
+            {
+                next = next->next;
+            }
+            if (next->early)
+            {
+                next = q->head;
+            }
+        }
+        cmd->next = next;
+        cmd->prev = next->prev;
+        cmd->next->prev = cmd->prev->next = cmd;
+        if (next == q->head && early && !ready && !next->early)
+        {
+            q->head = cmd;
+        }
+    }
+    else
+    {
+        cmd->next = cmd->prev = cmd;
+        q->head = cmd;
+    }
+
+    if (++q->stats.depth > q->stats.max_depth)
+    {
+        q->stats.max_depth = q->stats.depth;
+    }
+
+    return 1;
+}
+
+/*
+ * Remove the command at the head of the queue once its response is
+ * complete. A combined command is only removed on the second call, as
+ * its response consists of a SUCCESS line followed by data up to END.
+ * Returns 0 if the queue is empty.
+ */
+int
+mgmt_cmd_remove(mgmt_cmd_queue_t *q)
+{
+    mgmt_cmd_t *cmd = q->head;
+    if (!cmd)
+    {
+        return 0;
+    }
+
+    if (cmd->type == combined)
+    {
+        /* Wipe command as it may contain passwords */
+        mgmt_wipe(cmd->command, cmd->len);
+        cmd->type = regular;
+        return 1;
+    }
+
+    if (cmd->next == cmd)
+    {
+        q->head = NULL;
+    }
+    else
+    {
+        cmd->prev->next = cmd->next;
+        cmd->next->prev = cmd->prev;
+        q->head = cmd->next;
+    }
+
+    q->stats.depth--;
+    release_cmd(q, cmd);
+
+    return 1;
+}
+
+/*
+ * Collect the bytes of all commands not yet sent. Commands other than
+ * early ones are held back unless the interface is ready. The data is
+ * copied to buf, except when the first pending command is larger than buf:
+ * *data then points to that command alone.
+ * Returns the number of bytes at *data.
+ */
+size_t
+mgmt_cmd_pending(mgmt_cmd_queue_t *q, int ready, char *buf, size_t size,
+                 const char **data)
+{
+    mgmt_cmd_t *cmd = q->head;
+    size_t len = 0;
+
+    *data = buf;
+    if (cmd == NULL)
+    {
+        return 0;
+    }
+
+    do
+    {
+        const char *pending = cmd->command + cmd->len - cmd->size;
+        if (cmd->size == 0)
+        {
+            continue; /* already sent */
+        }
+
+        /* hold commands until the management interface is ready */
+        if (!ready && !cmd->early)
+        {
+            break;
+        }
+
+        if (len + cmd->size > size)
+        {
+            if (len == 0)
+            {
+                /* too long to batch: send this one on its own */
+                *data = pending;
+                return cmd->size;
+            }
+            break;
+        }
+
+        memcpy(buf + len, pending, cmd->size);
+        len += cmd->size;
+    } while ((cmd = cmd->next) != q->head);
+
+    return len;
+}
+
+/*
+ * Account for n bytes of pending data sent
+ */
+void
+mgmt_cmd_sent(mgmt_cmd_queue_t *q, size_t n)
+{
+    for (mgmt_cmd_t *cmd = q->head; cmd && n > 0; cmd = cmd->next)
+    {
+        size_t k = n < (size_t) cmd->size ? n : (size_t) cmd->size;
+        cmd->size -= (int) k;
+        n -= k;
+    }
+}
+
+/*
+ * Drop all queued commands and free the commands kept for reuse
+ */
+void
+mgmt_cmd_clear(mgmt_cmd_queue_t *q)
+{
+    while (mgmt_cmd_remove(q))
+    {
+    }
+
+    mgmt_cmd_t *cmd = q->free;
+    while (cmd)
+    {
+        mgmt_cmd_t *next = cmd->next;
+        free(cmd);
+        cmd = next;
+    }
+    q->free = NULL;
+    q->stats.pooled = 0;
+}
+
+/*
+ * Dispatch one line of management interface output: real-time messages
+ * go to their handler, anything else is a response to the command at the
+ * head of the queue. The ready notification is not dispatched as its
+ * handling depends on the platform. Returns the type of the real-time
+ * message with *msg pointing past its prefix, or mgmt_rtmsg_type_max.
+ */
+mgmt_rtmsg_type
+mgmt_dispatch_line(struct connection *c, mgmt_cmd_queue_t *q,
+                   const mgmt_msg_func *handler, char *line, char **msg)
+{
+    mgmt_cmd_t *cmd = q->head;
+
+    *msg = NULL;
+
+    if (line[0] == '>')
+    {
+        /* Real time notifications */
+        size_t len = 0;
+        mgmt_rtmsg_type type = mgmt_rtmsg_lookup(line + 1, &len);
+
+        if (type == mgmt_rtmsg_type_max)
+        {
+            return type;
+        }
+        *msg = line + 1 + len;
+
+        if (type == pkcs11_id_count_)
+        {
+            /* This is not a real-time message, but unfortunately implemented
+             * in the core as one. Work around by handling the response here.
+             */
+            if (cmd)
+            {
+                if (cmd->handler)
+                {
+                    cmd->handler(c, line);
+                }
+                mgmt_cmd_remove(q);
+            }
+        }
+        else if (type != ready_ && handler[type])
+        {
+            handler[type](c, *msg);
+        }
+        return type;
+    }
+
+    if (cmd == NULL)
+    {
+        return mgmt_rtmsg_type_max;
+    }
+
+    /* Response to commands */
+    if (strncmp(line, "SUCCESS:", 8) == 0)
+    {
+        if (cmd->handler)
+        {
+            cmd->handler(c, line + 9);
+        }
+        mgmt_cmd_remove(q);
+    }
+    else if (strncmp(line, "ERROR:", 6) == 0)
+    {
+        /* Response sent to management is not processed. Log an error in status window  */
+        char buf[256];
+        snprintf(buf, sizeof(buf), "%lld,N,Previous command sent to management failed: %s",
+                 (long long)time(NULL), line);
+        if (handler[log_])
+        {
+            handler[log_](c, buf);
+        }
+
+        if (cmd->handler)
+        {
+            cmd->handler(c, NULL);
+        }
+        mgmt_cmd_remove(q);
+    }
+    else if (strcmp(line, "END") == 0)
+    {
+        mgmt_cmd_remove(q);
+    }
+    else if (cmd->handler)
+    {
+        cmd->handler(c, line);
+    }
+
+    return mgmt_rtmsg_type_max;
+}
@@ -0,0 +1,150 @@
+/*
+ *  OpenVPN-GUI -- A Windows GUI for OpenVPN.
+ *
+ *  Copyright (C) 2010 Heiko Hund <heikoh@users.sf.net>
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program (see the file COPYING included with this
+ *  distribution); if not, write to the Free Software Foundation, Inc.,
+ *  59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+#ifndef MGMT_PROTO_H
+#define MGMT_PROTO_H
+
+/*
+ * Platform independent part of the OpenVPN management protocol: framing
+ * of received data into lines, lookup and dispatch of real-time messages
+ * and the queue of commands awaiting a response. No I/O is done here and
+ * only the C library is used -- the socket handling lives in manage.c.
+ */
+
+#include <stddef.h>
+
+struct connection;
+
+typedef enum {
+    ready_,
+    stop_,
+    bytecount_,
+    echo_,
+    hold_,
+    log_,
+    password_,
+    proxy_,
+    state_,
+    needok_,
+    needstr_,
+    pkcs11_id_count_,
+    infomsg_,
+    timeout_,
+    mgmt_rtmsg_type_max
+} mgmt_rtmsg_type;
+
+typedef enum {
+    regular,
+    combined
+} mgmt_cmd_type;
+
+typedef void (*mgmt_msg_func)(struct connection *, char *);
+
+/*
+ * Receive buffer for management interface output. Received data is
+ * appended at the tail and lines are parsed in place starting at
+ * data + start. Unprocessed bytes are moved to the front of the buffer only
+ * when the tail runs out of room, so lines are always contiguous in memory.
+ * While busy > 0 lines are being dispatched and handlers may hold pointers
+ * into the buffer: it is then never moved in place. If more room is needed
+ * the unprocessed bytes are copied to a new buffer and the old one is kept
+ * in the retired list until processing unwinds.
+ */
+typedef struct mgmt_rbuf_retired {
+    struct mgmt_rbuf_retired *next;
+    char *data;
+} mgmt_rbuf_retired_t;
+
+typedef struct {
+    char *data;
+    size_t size;                    /* allocated size of data */
+    size_t start;                   /* offset of the first unprocessed byte */
+    size_t len;                     /* number of unprocessed bytes */
+    int busy;                       /* nesting depth of line processing */
+    mgmt_rbuf_retired_t *retired;   /* buffers replaced while busy */
+} mgmt_rbuf_t;
+
+#define MGMT_CMD_INLINE_SIZE 128    /* commands up to this length are stored inline */
+#define MGMT_CMD_POOL_MAX    8      /* max number of released commands kept for reuse */
+
+typedef struct mgmt_cmd {
+    struct mgmt_cmd *prev, *next;
+    char *command;                  /* points to inline_buf or heap storage */
+    int size;                       /* number of bytes not yet sent */
+    int len;                        /* length of the command including newline */
+    mgmt_msg_func handler;
+    mgmt_cmd_type type;
+    int early;                      /* may be sent before the interface is ready */
+    char inline_buf[MGMT_CMD_INLINE_SIZE];
+} mgmt_cmd_t;
+
+/* Command queue statistics of a connection */
+typedef struct {
+    unsigned int depth;             /* number of commands in the queue */
+    unsigned int max_depth;         /* largest depth seen */
+    unsigned int pooled;            /* number of commands in the free list */
+    unsigned long allocs;           /* commands allocated from the heap */
+    unsigned long reused;           /* commands taken from the free list */
+    unsigned long long_cmds;        /* commands too long for inline storage */
+} mgmt_cmd_stats_t;
+
+/* Commands awaiting a response, oldest first */
+typedef struct {
+    mgmt_cmd_t *head;
+    mgmt_cmd_t *free;               /* released commands kept for reuse */
+    mgmt_cmd_stats_t stats;
+} mgmt_cmd_queue_t;
+
+
+void mgmt_rtmsg_init(void);
+
+mgmt_rtmsg_type mgmt_rtmsg_lookup(const char *msg, size_t *len);
+
+char *mgmt_rbuf_reserve(mgmt_rbuf_t *rb, size_t need, size_t *avail);
+
+void mgmt_rbuf_commit(mgmt_rbuf_t *rb, size_t n);
+
+char *mgmt_rbuf_getline(mgmt_rbuf_t *rb, int *passwd_prompt);
+
+void mgmt_rbuf_begin(mgmt_rbuf_t *rb);
+
+void mgmt_rbuf_end(mgmt_rbuf_t *rb, int release);
+
+void mgmt_rbuf_reset(mgmt_rbuf_t *rb);
+
+int mgmt_cmd_add(mgmt_cmd_queue_t *q, const char *command, mgmt_msg_func handler,
+                 mgmt_cmd_type type, int early, int ready);
+
+int mgmt_cmd_remove(mgmt_cmd_queue_t *q);
+
+size_t mgmt_cmd_pending(mgmt_cmd_queue_t *q, int ready, char *buf, size_t size,
+                        const char **data);
+
+void mgmt_cmd_sent(mgmt_cmd_queue_t *q, size_t n);
+
+void mgmt_cmd_clear(mgmt_cmd_queue_t *q);
+
+mgmt_rtmsg_type mgmt_dispatch_line(struct connection *c, mgmt_cmd_queue_t *q,
+                                   const mgmt_msg_func *handler, char *line, char **msg);
+
+void mgmt_wipe(void *p, size_t n);
+
+#endif /* ifndef MGMT_PROTO_H */
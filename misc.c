@@ -43,44 +43,26 @@
 #include "openvpn-gui-res.h"
 #include "tray.h"
 #include "config_parser.h"
+#include "codec.h"
 
 /*
- * Helper function to do base64 conversion through CryptoAPI
- * Returns TRUE on success, FALSE on error. Caller must free *output.
+ * Base64 encode input and return the result as a newly allocated
+ * string in *output. Returns TRUE on success, FALSE on error.
+ * Caller must free *output.
  */
 BOOL
 Base64Encode(const char *input, int input_len, char **output)
 {
-    DWORD output_len;
-    DWORD flags = CRYPT_STRING_BASE64|CRYPT_STRING_NOCRLF;
+    size_t size = BASE64_ENCODE_SIZE((size_t) input_len);
 
-    if (input_len == 0)
-    {
-        /* set output to empty string  -- matches the behavior in openvpn */
-        *output = calloc(1, sizeof(char));
-        return TRUE;
-    }
-    if (!CryptBinaryToStringA((const BYTE *) input, (DWORD) input_len,
-                              flags, NULL, &output_len) || output_len == 0)
-    {
-#ifdef DEBUG
-        PrintDebug(L"Error in CryptBinaryToStringA: input = '%.*hs'", input_len, input);
-#endif
-        *output = NULL;
-        return FALSE;
-    }
-    *output = (char *)malloc(output_len);
+    /* empty input gives an empty string -- matches the behavior in openvpn */
+    *output = malloc(size);
     if (*output == NULL)
     {
         return FALSE;
     }
-
-    if (!CryptBinaryToStringA((const BYTE *) input, (DWORD) input_len,
-                              flags, *output, &output_len))
+    if (base64_encode(input, input_len, *output, size) < 0)
     {
-#ifdef DEBUG
-        PrintDebug(L"Error in CryptBinaryToStringA: input = '%.*hs'", input_len, input);
-#endif
         free(*output);
         *output = NULL;
         return FALSE;
@@ -88,6 +70,7 @@ Base64Encode(const char *input, int input_len, char **output)
 
     return TRUE;
 }
+
 /*
  * Decode a nul-terminated base64 encoded input and save the result in
  * an allocated buffer *output. The caller must free *output after use.
@@ -100,24 +83,19 @@ Base64Encode(const char *input, int input_len, char **output)
 int
 Base64Decode(const char *input, char **output)
 {
-    DWORD len;
+    size_t input_len = strlen(input);
+    size_t size = BASE64_DECODE_SIZE(input_len);
 
     PrintDebug(L"decoding %hs", input);
-    if (!CryptStringToBinaryA(input, 0, CRYPT_STRING_BASE64_ANY,
-                              NULL, &len, NULL, NULL) || len == 0)
-    {
-        *output = NULL;
-        return -1;
-    }
 
-    *output = malloc(len + 1);
+    *output = malloc(size + 1);
     if (*output == NULL)
     {
         return -1;
     }
 
-    if (!CryptStringToBinaryA(input, 0,
-                              CRYPT_STRING_BASE64, (BYTE *) *output, &len, NULL, NULL))
+    int len = base64_decode(input, input_len, *output, size);
+    if (len <= 0)
     {
         free(*output);
         *output = NULL;
@@ -635,92 +613,6 @@ CloseHandleEx(LPHANDLE handle)
     }
 }
 
-/*
- * Decode url encoded characters in buffer src and
- * return the result in a newly allocated buffer. The
- * caller should free the returned pointer. Returns
- * NULL on memory allocation error.
- */
-char *
-url_decode(const char *src)
-{
-    const char *s = src;
-    char *out = malloc(strlen(src) + 1); /* output is guaranteed to be not longer than src */
-    char *o;
-
-    if (!out)
-    {
-        return NULL;
-    }
-
-    for (o = out; *s; o++)
-    {
-        unsigned int c = *s++;
-        if (c == '%' && isxdigit(s[0]) && isxdigit(s[1]))
-        {
-            sscanf(s, "%2x", &c);
-            s += 2;
-        }
-        /* We passthough all other chars including % not followed by 2 hex digits */
-        *o = (char)c;
-    }
-    *o = '\0';
-
-    return out;
-}
-
-DWORD
-md_init(md_ctx *ctx, ALG_ID hash_type)
-{
-    DWORD status = 0;
-
-    if (!CryptAcquireContext(&ctx->prov, NULL, NULL, PROV_RSA_FULL, CRYPT_VERIFYCONTEXT))
-    {
-        goto err;
-    }
-    if (!CryptCreateHash(ctx->prov, hash_type, 0, 0, &ctx->hash))
-    {
-        CryptReleaseContext(ctx->prov, 0);
-        goto err;
-    }
-
-    return status;
-
-err:
-    status = GetLastError();
-    MsgToEventLog(EVENTLOG_ERROR_TYPE, L"Error in md_ctx_init: status = %lu", status);
-    return status;
-}
-
-DWORD
-md_update(md_ctx *ctx, const BYTE *data, size_t size)
-{
-    DWORD status = 0;
-
-    if (!CryptHashData(ctx->hash, data, (DWORD)size, 0))
-    {
-        status = GetLastError();
-        MsgToEventLog(EVENTLOG_ERROR_TYPE, L"Error in md_update: status = %lu", status);
-    }
-    return status;
-}
-
-DWORD
-md_final(md_ctx *ctx, BYTE *md)
-{
-    DWORD status = 0;
-
-    DWORD digest_len = HASHLEN;
-    if (!CryptGetHashParam(ctx->hash, HP_HASHVAL, md, &digest_len, 0))
-    {
-        status = GetLastError();
-        MsgToEventLog(EVENTLOG_ERROR_TYPE, L"Error in md_final: status = %lu", status);
-    }
-    CryptDestroyHash(ctx->hash);
-    CryptReleaseContext(ctx->prov, 0);
-    return status;
-}
-
 /* Open specified http/https URL using ShellExecute. */
 BOOL
 open_url(const wchar_t *url)
@@ -862,6 +754,39 @@ out:
     return ret;
 }
 
+/* Management address, password file and working directory found in a config */
+struct mgmt_query {
+    SOCKADDR_IN *addr;
+    BOOL have_pw_file;
+    wchar_t pw_file[MAX_PATH];
+    wchar_t workdir[MAX_PATH];
+};
+
+/* config_query callback for management and cd directives -- the last one of each wins */
+static int
+ManagementDirective(void *arg, char **tokens, int ntokens)
+{
+    struct mgmt_query *q = arg;
+
+    if (ntokens >= 3 && streq(tokens[0], "management"))
+    {
+        /* we require the address to be a numerical ipv4 address -- e.g., 127.0.0.1*/
+        if (inet_pton(AF_INET, tokens[1], &q->addr->sin_addr) != 1)
+        {
+            return 1; /* stop parsing */
+        }
+
+        q->addr->sin_port = htons(atoi(tokens[2]));
+        q->have_pw_file = (ntokens > 3
+                           && MultiByteToWideChar(CP_UTF8, 0, tokens[3], -1, q->pw_file, _countof(q->pw_file)) > 0);
+    }
+    else if (ntokens >= 2 && streq(tokens[0], "cd"))
+    {
+        MultiByteToWideChar(CP_UTF8, 0, tokens[1], -1, q->workdir, _countof(q->workdir));
+    }
+    return 0;
+}
+
 /* Parse the management address and password
  * from a config file. Results are returned
  * in c->manage.skaddr and c->magage.password.
@@ -871,44 +796,28 @@ out:
 BOOL
 ParseManagementAddress(connection_t *c)
 {
+    static const char *const directives[] = {"management", "cd", NULL};
     BOOL ret = true;
     wchar_t *pw_file = NULL;
-    wchar_t *workdir = c->config_dir;
+    wchar_t *workdir;
     wchar_t config_path[MAX_PATH];
     wchar_t pw_path[MAX_PATH] = L"";
+    struct mgmt_query q = {.addr = &c->manage.skaddr};
 
     _sntprintf_0(config_path, L"%ls\\%ls", c->config_dir, c->config_file);
+    wcsncpy_s(q.workdir, _countof(q.workdir), c->config_dir, _TRUNCATE);
 
-    config_entry_t *head = config_parse(config_path);
-    config_entry_t *l = head;
+    SOCKADDR_IN *addr = &c->manage.skaddr;
+    addr->sin_port = 0;
 
-    if (!head)
+    if (config_query(config_path, directives, ManagementDirective, &q) != 0)
     {
         return false;
     }
-
-    SOCKADDR_IN *addr = &c->manage.skaddr;
-    addr->sin_port = 0;
-
-    while (l)
+    workdir = q.workdir;
+    if (q.have_pw_file)
     {
-        if (l->ntokens >= 3 && !wcscmp(l->tokens[0], L"management"))
-        {
-            /* we require the address to be a numerical ipv4 address -- e.g., 127.0.0.1*/
-            if (InetPtonW(AF_INET, l->tokens[1], &addr->sin_addr) != 1)
-            {
-                config_list_free(head);
-                return false;
-            }
-
-            addr->sin_port = htons(_wtoi(l->tokens[2]));
-            pw_file = l->tokens[3]; /* may be null */
-        }
-        else if (l->ntokens >= 2 && !wcscmp(l->tokens[0], L"cd"))
-        {
-            workdir = l->tokens[1];
-        }
-        l = l->next;
+        pw_file = q.pw_file;
     }
 
     ret = (addr->sin_port != 0);
@@ -929,22 +838,25 @@ ParseManagementAddress(connection_t *c)
         }
 
         FILE *fp = _wfopen(pw_path, L"r");
-        if (!fp
-            || !fgets(c->manage.password, sizeof(c->manage.password), fp))
+        char *password = AllocManagementPassword(c);
+        if (!fp || !password
+            || !fgets(password, MGMT_PASSWORD_SIZE, fp))
         {
             MsgToEventLog(EVENTLOG_ERROR_TYPE,  L"Error processing --management option: failed to read password file <%ls>", pw_file);
             /* This may be normal as not all users may be given access to this secret */
             ret = false;
+            FreeManagementPassword(c);
+        }
+        else
+        {
+            StrTrimA(password, "\n\r");
         }
-
-        StrTrimA(c->manage.password, "\n\r");
 
         if (fp)
         {
             fclose(fp);
         }
     }
-    config_list_free(head);
 
     PrintDebug(L"ParseManagementAddress: host = %hs port = %d passwd_file = %s",
                inet_ntoa(addr->sin_addr), ntohs(addr->sin_port), pw_path);
@@ -407,5 +407,8 @@
 
 /* Timer IDs */
 #define IDT_STOP_TIMER                  2500  /* Timer used to trigger force termination */
+#define IDT_MGMT_READY_TIMER            2501  /* Timer used to confirm management is ready for input */
+#define IDT_LOG_FLUSH_TIMER             2502  /* Timer used to display pending status log lines */
+#define IDT_TRAY_REFRESH_TIMER          2503  /* Timer used to coalesce tray icon updates */
 
 #endif /* ifndef OPENVPN_GUI_RES_H */
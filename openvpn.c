@@ -59,6 +59,7 @@
 #include "save_pass.h"
 #include "env_set.h"
 #include "echo.h"
+#include "statuslog.h"
 #include "pkcs11.h"
 
 #define OPENVPN_SERVICE_PIPE_NAME_OVPN2 L"\\\\.\\pipe\\openvpn\\service"
@@ -166,7 +167,7 @@ OnHold(connection_t *c, UNUSED char *msg)
         && (c->state == disconnecting || c->state == resuming))
     {
         /* retain the hold state if we are here while disconnecting  */
-        c->state = onhold;
+        SetConnState(c, onhold);
         SetMenuStatus(c, onhold);
         SetDlgItemText(c->hwndStatus, ID_TXT_STATUS, LoadLocalizedString(IDS_NFO_STATE_ONHOLD));
         SetStatusWinIcon(c->hwndStatus, ID_ICO_DISCONNECTED);
@@ -186,14 +187,9 @@ OnHold(connection_t *c, UNUSED char *msg)
 void
 OnLogLine(connection_t *c, char *line)
 {
-    HWND logWnd = GetDlgItem(c->hwndStatus, ID_EDT_LOG);
     char *flags, *message;
     time_t timestamp;
-    TCHAR *datetime;
-    const SETTEXTEX ste = {
-        .flags = ST_SELECTION,
-        .codepage = CP_UTF8
-    };
+    const char *datetime;
 
     flags = strchr(line, ',') + 1;
     if (flags - 1 == NULL)
@@ -208,20 +204,8 @@ OnLogLine(connection_t *c, char *line)
     }
     size_t flag_size = message - flags - 1; /* message is always > flags */
 
-    /* Remove lines from log window if it is getting full */
-    if (SendMessage(logWnd, EM_GETLINECOUNT, 0, 0) > MAX_LOG_LINES)
-    {
-        int pos = SendMessage(logWnd, EM_LINEINDEX, DEL_LOG_LINES, 0);
-        SendMessage(logWnd, EM_SETSEL, 0, pos);
-        SendMessage(logWnd, EM_REPLACESEL, FALSE, (LPARAM) _T(""));
-    }
-
     timestamp = strtol(line, NULL, 10);
-    datetime = _tctime(&timestamp);
-    datetime[24] = _T(' ');
-
-    /* deselect current selection, if any */
-    SendMessage(logWnd, EM_SETSEL, (WPARAM) -1, (LPARAM) -1);
+    datetime = StatusLogTime(&c->log.time, timestamp);
 
     /* change text color if Warning or Error */
     COLORREF text_clr = 0;
@@ -235,22 +219,11 @@ OnLogLine(connection_t *c, char *line)
         text_clr = o.clr_warning;
     }
 
-    if (text_clr != 0)
-    {
-        CHARFORMAT cfm = { .cbSize = sizeof(CHARFORMAT),
-                           .dwMask = CFM_COLOR|CFM_BOLD,
-                           .dwEffects = 0,
-                           .crTextColor = text_clr, };
-        SendMessage(logWnd, EM_SETCHARFORMAT, SCF_SELECTION, (LPARAM) &cfm);
-    }
-
-    /* Append line to log window */
-    SendMessage(logWnd, EM_REPLACESEL, FALSE, (LPARAM) datetime);
-    SendMessage(logWnd, EM_SETTEXTEX, (WPARAM) &ste, (LPARAM) message);
-    SendMessage(logWnd, EM_REPLACESEL, FALSE, (LPARAM) _T("\n"));
-
-    /* scroll to the caret */
-    SendMessage(logWnd, EM_SCROLLCARET, 0, 0);
+    /* Queue line for the log window */
+    StatusLogBegin(c, text_clr);
+    StatusLogAppendA(c, datetime);
+    StatusLogAppendA(c, message);
+    StatusLogEnd(c);
 }
 
 /* expect ipv4,remote,port,,,ipv6 */
@@ -410,10 +383,10 @@ OnStateChange(connection_t *c, char *data)
         c->connected_since = atoi(data);
         c->failed_psw_attempts = 0;
         c->failed_auth_attempts = 0;
-        c->state = connected;
+        SetConnState(c, connected);
 
         SetMenuStatus(c, connected);
-        SetTrayIcon(connected);
+        CheckAndSetTrayIcon();
 
         SetDlgItemText(c->hwndStatus, ID_TXT_STATUS, LoadLocalizedString(IDS_NFO_STATE_CONNECTED));
         SetDlgItemTextW(c->hwndStatus, ID_TXT_IP, ip_txt);
@@ -447,7 +420,7 @@ OnStateChange(connection_t *c, char *data)
         /* We change the state to reconnecting only if there was a prior successful connection. */
         if (c->state == connected)
         {
-            c->state = reconnecting;
+            SetConnState(c, reconnecting);
 
             /* Update the tray icon */
             CheckAndSetTrayIcon();
@@ -1506,7 +1479,7 @@ OnTimeout(connection_t *c, UNUSED char *msg)
     }
     WriteStatusLog(c, L"GUI> ", LoadLocalizedString(IDS_NFO_CONN_TIMEOUT, c->log_path), false);
     WriteStatusLog(c, L"GUI> ", L"Retrying. Press disconnect to abort", false);
-    c->state = connecting;
+    SetConnState(c, connecting);
     if (!OpenManagement(c))
     {
         MessageBoxExW(c->hwndStatus, L"Failed to open management", _T(PACKAGE_NAME),
@@ -1531,7 +1504,7 @@ OnStop(connection_t *c, UNUSED char *msg)
             /* OpenVPN process ended unexpectedly */
             c->failed_psw_attempts = 0;
             c->failed_auth_attempts = 0;
-            c->state = disconnected;
+            SetConnState(c, disconnected);
             CheckAndSetTrayIcon();
             SetDlgItemText(c->hwndStatus, ID_TXT_STATUS, LoadLocalizedString(IDS_NFO_STATE_DISCONNECTED));
             SetStatusWinIcon(c->hwndStatus, ID_ICO_DISCONNECTED);
@@ -1554,9 +1527,9 @@ OnStop(connection_t *c, UNUSED char *msg)
             txt_id = c->state == reconnecting ? IDS_NFO_STATE_FAILED_RECONN : IDS_NFO_STATE_FAILED;
             msg_id = c->state == reconnecting ? IDS_NFO_RECONN_FAILED : IDS_NFO_CONN_FAILED;
 
-            c->state = disconnecting;
+            SetConnState(c, disconnecting);
             CheckAndSetTrayIcon();
-            c->state = disconnected;
+            SetConnState(c, disconnected);
             EnableWindow(GetDlgItem(c->hwndStatus, ID_DISCONNECT), FALSE);
             EnableWindow(GetDlgItem(c->hwndStatus, ID_RESTART), FALSE);
             SetStatusWinIcon(c->hwndStatus, ID_ICO_DISCONNECTED);
@@ -1575,7 +1548,7 @@ OnStop(connection_t *c, UNUSED char *msg)
             /* Shutdown was initiated by us */
             c->failed_psw_attempts = 0;
             c->failed_auth_attempts = 0;
-            c->state = disconnected;
+            SetConnState(c, disconnected);
             if (c->flags & FLAG_DAEMON_PERSISTENT)
             {
                 /* user initiated disconnection -- stay detached and do not auto-reconnect */
@@ -1589,13 +1562,13 @@ OnStop(connection_t *c, UNUSED char *msg)
         case onhold:
         /* stop triggered while on hold -- possibly the daemon exited. Treat same as detaching */
         case detaching:
-            c->state = disconnected;
+            SetConnState(c, disconnected);
             CheckAndSetTrayIcon();
             SendMessage(c->hwndStatus, WM_CLOSE, 0, 0);
             break;
 
         case suspending:
-            c->state = suspended;
+            SetConnState(c, suspended);
             CheckAndSetTrayIcon();
             SetDlgItemText(c->hwndStatus, ID_TXT_STATUS, LoadLocalizedString(IDS_NFO_STATE_SUSPENDED));
             break;
@@ -1752,6 +1725,57 @@ WrapLine(WCHAR *line)
     return next;
 }
 
+/*
+ * A line posted to the status thread with WM_OVPN_LOGLINE. The texts are
+ * stored after the struct in the same allocation, which the receiver frees.
+ */
+typedef struct {
+    const WCHAR *prefix;
+    const WCHAR *line;
+    BOOL fileio;
+} status_log_msg_t;
+
+/*
+ * Post a copy of a log line to the status window. Returns false if that
+ * fails, e.g., because the window has been destroyed.
+ */
+static BOOL
+PostStatusLogLine(HWND hwnd, const WCHAR *prefix, const WCHAR *line, BOOL fileio)
+{
+    size_t prefix_len = wcslen(prefix) + 1;
+    size_t line_len = wcslen(line) + 1;
+    status_log_msg_t *msg = malloc(sizeof(*msg) + (prefix_len + line_len) * sizeof(WCHAR));
+
+    if (!msg)
+    {
+        return FALSE;
+    }
+
+    WCHAR *text = (WCHAR *) (msg + 1);
+    wmemcpy(text, prefix, prefix_len);
+    wmemcpy(text + prefix_len, line, line_len);
+    msg->prefix = text;
+    msg->line = text + prefix_len;
+    msg->fileio = fileio;
+
+    if (!PostMessage(hwnd, WM_OVPN_LOGLINE, 0, (LPARAM) msg))
+    {
+        free(msg);
+        return FALSE;
+    }
+    return TRUE;
+}
+
+/*
+ * Write out a line received with WM_OVPN_LOGLINE and free it
+ */
+static void
+WriteStatusLogMsg(connection_t *c, status_log_msg_t *msg)
+{
+    WriteStatusLog(c, msg->prefix, msg->line, msg->fileio);
+    free(msg);
+}
+
 /*
  * Write a line to the status log window and optionally to the log file
  */
@@ -1764,15 +1788,20 @@ WriteStatusLog(connection_t *c, const WCHAR *prefix, const WCHAR *line, BOOL fil
         return;
     }
 
-    HWND logWnd = GetDlgItem(c->hwndStatus, ID_EDT_LOG);
-    FILE *log_fd;
-    time_t now;
-    WCHAR datetime[26];
+    /* The pending lines in c->log belong to the thread of the status window:
+     * lines from other threads are posted to it, without waiting for that
+     * thread. If that fails, or there is no window, only the log file is
+     * written.
+     */
+    HWND hwnd = c->hwndStatus;
+    BOOL own = (hwnd && GetWindowThreadProcessId(hwnd, NULL) == GetCurrentThreadId());
+    if (hwnd && !own && PostStatusLogLine(hwnd, prefix, line, fileio))
+    {
+        return;
+    }
 
-    time(&now);
-    /* TODO: change this to use _wctime_s when mingw supports it */
-    wcsncpy(datetime, _wctime(&now), _countof(datetime));
-    datetime[24] = L' ';
+    log_time_t time_cache = { 0 };
+    const char *datetime = StatusLogTime(own ? &c->log.time : &time_cache, time(NULL));
 
     /* change text color if Warning or Error */
     COLORREF text_clr = 0;
@@ -1786,39 +1815,25 @@ WriteStatusLog(connection_t *c, const WCHAR *prefix, const WCHAR *line, BOOL fil
         text_clr = o.clr_warning;
     }
 
-    if (text_clr != 0)
+    /* Queue line for the log window */
+    if (own)
     {
-        CHARFORMAT cfm = { .cbSize = sizeof(CHARFORMAT),
-                           .dwMask = CFM_COLOR|CFM_BOLD,
-                           .dwEffects = 0,
-                           .crTextColor = text_clr, };
-        SendMessage(logWnd, EM_SETCHARFORMAT, SCF_SELECTION, (LPARAM) &cfm);
+        StatusLogBegin(c, text_clr);
+        StatusLogAppendA(c, datetime);
+        StatusLogAppendW(c, prefix);
+        StatusLogAppendW(c, line);
+        StatusLogEnd(c);
     }
 
-
-    /* Remove lines from log window if it is getting full */
-    if (SendMessage(logWnd, EM_GETLINECOUNT, 0, 0) > MAX_LOG_LINES)
-    {
-        int pos = SendMessage(logWnd, EM_LINEINDEX, DEL_LOG_LINES, 0);
-        SendMessage(logWnd, EM_SETSEL, 0, pos);
-        SendMessage(logWnd, EM_REPLACESEL, FALSE, (LPARAM) _T(""));
-    }
-    /* Append line to log window */
-    SendMessage(logWnd, EM_SETSEL, (WPARAM) -1, (LPARAM) -1);
-    SendMessage(logWnd, EM_REPLACESEL, FALSE, (LPARAM) datetime);
-    SendMessage(logWnd, EM_REPLACESEL, FALSE, (LPARAM) prefix);
-    SendMessage(logWnd, EM_REPLACESEL, FALSE, (LPARAM) line);
-    SendMessage(logWnd, EM_REPLACESEL, FALSE, (LPARAM) L"\n");
-
     if (!fileio)
     {
         return;
     }
 
-    log_fd = _tfopen(c->log_path, TEXT("at+,ccs=UTF-8"));
+    FILE *log_fd = _tfopen(c->log_path, TEXT("at+,ccs=UTF-8"));
     if (log_fd)
     {
-        fwprintf(log_fd, L"%ls%ls%ls\n", datetime, prefix, line);
+        fwprintf(log_fd, L"%hs%ls%ls\n", datetime, prefix, line);
         fclose(log_fd);
     }
 }
@@ -2147,12 +2162,14 @@ static void
 Cleanup(connection_t *c)
 {
     CloseManagement(c);
+    FreeManagementPassword(c);
 
     free_dynamic_cr(c);
     env_item_del_all(c->es);
     c->es = NULL;
     echo_msg_clear(c, true); /* clear history */
     pkcs11_list_clear(&c->pkcs11_list);
+    StatusLogFree(c);
 
     if (c->hProcess)
     {
@@ -2202,7 +2219,8 @@ StatusDialogFunc(HWND hwndDlg, UINT msg, WPARAM wParam, LPARAM lParam)
     {
         case WM_MANAGEMENT:
             /* Management interface related event */
-            OnManagement(wParam, lParam);
+            c = (connection_t *) GetProp(hwndDlg, cfgProp);
+            OnManagement(c, wParam, lParam);
             return TRUE;
 
         case WM_INITDIALOG:
@@ -2339,6 +2357,7 @@ StatusDialogFunc(HWND hwndDlg, UINT msg, WPARAM wParam, LPARAM lParam)
 
         case WM_NCDESTROY:
             KillTimer(hwndDlg, IDT_STOP_TIMER);
+            KillTimer(hwndDlg, IDT_LOG_FLUSH_TIMER);
             RemoveProp(hwndDlg, cfgProp);
             break;
 
@@ -2348,7 +2367,7 @@ StatusDialogFunc(HWND hwndDlg, UINT msg, WPARAM wParam, LPARAM lParam)
 
         case WM_OVPN_RELEASE:
             c = (connection_t *) GetProp(hwndDlg, cfgProp);
-            c->state = reconnecting;
+            SetConnState(c, reconnecting);
             SetDlgItemText(c->hwndStatus, ID_TXT_STATUS, LoadLocalizedString(IDS_NFO_STATE_RECONNECTING));
             SetDlgItemTextW(c->hwndStatus, ID_TXT_IP, L"");
             SetStatusWinIcon(c->hwndStatus, ID_ICO_CONNECTING);
@@ -2363,7 +2382,7 @@ StatusDialogFunc(HWND hwndDlg, UINT msg, WPARAM wParam, LPARAM lParam)
             {
                 break;
             }
-            c->state = disconnecting;
+            SetConnState(c, disconnecting);
             if (!(c->flags & FLAG_DAEMON_PERSISTENT))
             {
                 RunDisconnectScript(c, false);
@@ -2378,15 +2397,21 @@ StatusDialogFunc(HWND hwndDlg, UINT msg, WPARAM wParam, LPARAM lParam)
         case WM_OVPN_DETACH:
             c = (connection_t *) GetProp(hwndDlg, cfgProp);
             /* just stop the thread keeping openvpn.exe running */
-            c->state = detaching;
+            SetConnState(c, detaching);
             EnableWindow(GetDlgItem(c->hwndStatus, ID_DISCONNECT), FALSE);
             EnableWindow(GetDlgItem(c->hwndStatus, ID_RESTART), FALSE);
             OnStop(c, NULL);
             break;
 
+        case WM_OVPN_LOGLINE:
+            /* a line written from another thread */
+            c = (connection_t *) GetProp(hwndDlg, cfgProp);
+            WriteStatusLogMsg(c, (status_log_msg_t *) lParam);
+            break;
+
         case WM_OVPN_SUSPEND:
             c = (connection_t *) GetProp(hwndDlg, cfgProp);
-            c->state = suspending;
+            SetConnState(c, suspending);
             EnableWindow(GetDlgItem(c->hwndStatus, ID_DISCONNECT), FALSE);
             EnableWindow(GetDlgItem(c->hwndStatus, ID_RESTART), FALSE);
             SetMenuStatus(c, disconnecting);
@@ -2396,7 +2421,10 @@ StatusDialogFunc(HWND hwndDlg, UINT msg, WPARAM wParam, LPARAM lParam)
             break;
 
         case WM_TIMER:
-            PrintDebug(L"WM_TIMER message with wParam = %lu", wParam);
+            if (wParam != IDT_LOG_FLUSH_TIMER) /* too frequent to trace */
+            {
+                PrintDebug(L"WM_TIMER message with wParam = %lu", wParam);
+            }
             c = (connection_t *) GetProp(hwndDlg, cfgProp);
             if (wParam == IDT_STOP_TIMER)
             {
@@ -2405,6 +2433,14 @@ StatusDialogFunc(HWND hwndDlg, UINT msg, WPARAM wParam, LPARAM lParam)
                 KillTimer(hwndDlg, IDT_STOP_TIMER);
                 OnStop(c, NULL);
             }
+            else if (wParam == IDT_MGMT_READY_TIMER)
+            {
+                OnManagementReady(c);
+            }
+            else if (wParam == IDT_LOG_FLUSH_TIMER)
+            {
+                StatusLogFlush(c);
+            }
             break;
 
         case WM_OVPN_RESTART:
@@ -2412,7 +2448,7 @@ StatusDialogFunc(HWND hwndDlg, UINT msg, WPARAM wParam, LPARAM lParam)
             /* external messages can trigger when we are not ready -- check the state */
             if (IsWindowEnabled(GetDlgItem(c->hwndStatus, ID_RESTART)))
             {
-                c->state = reconnecting;
+                SetConnState(c, reconnecting);
                 ManagementCommand(c, "signal SIGHUP", NULL, regular);
                 SetDlgItemText(c->hwndStatus, ID_TXT_STATUS, LoadLocalizedString(IDS_NFO_STATE_RECONNECTING));
                 SetDlgItemTextW(c->hwndStatus, ID_TXT_IP, L"");
@@ -2453,7 +2489,7 @@ ThreadOpenVPNStatus(void *p)
         /* kill daemon process if we started it */
         SetEvent(c->exit_event);
         Cleanup(c);
-        c->state = disconnected;
+        SetConnState(c, disconnected);
         return 1;
     }
 
@@ -2533,6 +2569,12 @@ ThreadOpenVPNStatus(void *p)
         }
     }
 
+    /* write out lines posted to the window that were not handled */
+    while (PeekMessage(&msg, NULL, WM_OVPN_LOGLINE, WM_OVPN_LOGLINE, PM_REMOVE))
+    {
+        WriteStatusLogMsg(c, (status_log_msg_t *) msg.lParam);
+    }
+
     /* release handles etc.*/
     Cleanup(c);
     c->hwndStatus = NULL;
@@ -2693,7 +2735,7 @@ StartOpenVPN(connection_t *c)
             }
             else
             {
-                c->state = disconnected;
+                SetConnState(c, disconnected);
             }
             TerminateThread(hThread, 1);
             return false;
@@ -2706,7 +2748,7 @@ StartOpenVPN(connection_t *c)
         return false;
     }
 
-    c->state = (c->state == suspended || c->state == detached) ? resuming : connecting;
+    SetConnState(c, (c->state == suspended || c->state == detached) ? resuming : connecting);
 
     /* Start the status dialog thread */
     ResumeThread(hThread);
@@ -2734,9 +2776,9 @@ LaunchOpenVPN(connection_t *c)
     BOOL retval = FALSE;
     DWORD passwd_len = 16; /* incuding NUL */
 
-    if (passwd_len > sizeof(c->manage.password))
+    if (passwd_len > MGMT_PASSWORD_SIZE)
     {
-        passwd_len = sizeof(c->manage.password);
+        passwd_len = MGMT_PASSWORD_SIZE;
     }
 
     RunPreconnectScript(c);
@@ -2751,6 +2793,11 @@ LaunchOpenVPN(connection_t *c)
     }
 
     /* Create a management interface password */
+    if (!AllocManagementPassword(c))
+    {
+        CloseHandle(c->exit_event);
+        goto out;
+    }
     GetRandomPassword(c->manage.password, passwd_len - 1);
 
     find_free_tcp_port(&c->manage.skaddr);
@@ -2912,6 +2959,10 @@ LaunchOpenVPN(connection_t *c)
     retval = TRUE;
 
 out:
+    if (!retval)
+    {
+        FreeManagementPassword(c);
+    }
     if (hStdInWrite && hStdInWrite != INVALID_HANDLE_VALUE)
     {
         CloseHandle(hStdInWrite);
@@ -83,14 +83,7 @@ CheckReadAccess(const TCHAR *dir, const TCHAR *file)
 static int
 ConfigAlreadyExists(TCHAR *newconfig)
 {
-    for (connection_t *c = o.chead; c; c = c->next)
-    {
-        if (_tcsicmp(c->config_file, newconfig) == 0)
-        {
-            return true;
-        }
-    }
-    return false;
+    return GetConnByFile(newconfig) != NULL;
 }
 
 static void
@@ -121,6 +114,7 @@ AddConfigFileToList(int group, const TCHAR *filename, const TCHAR *config_dir)
     _tcsncpy(c->config_name, c->config_file, _countof(c->config_name) - 1);
     c->config_name[_tcslen(c->config_name) - _tcslen(o.ext_string) - 1] = _T('\0');
     _sntprintf_0(c->log_path, _T("%ls\\%ls.log"), o.log_dir, c->config_name);
+    AddConnToIndex(c);
 
     c->manage.sk = INVALID_SOCKET;
     c->manage.skaddr.sin_family = AF_INET;
@@ -285,32 +279,99 @@ ActivateConfigGroups(void)
     }
 }
 
-/* Scan for configs in config_dir recursing down up to recurse_depth.
- * Input: config_dir -- root of the directory to scan from
- *        group      -- the group into which add the configs to
- *        flags      -- enable warnings, use directory based
- *                      grouping of configs etc.
- * Currently configs in a directory are grouped together and group is
- * the id of the current group in the global group array |o.groups|
- * This may be recursively called until depth becomes 1 and each time
- * the group is changed to that of the directory being recursed into.
+/*
+ * Result of listing a config directory, kept across rescans so that
+ * directories whose last write time has not changed are not listed again.
+ * Adding, removing or renaming an entry updates the time of the directory
+ * containing it, but not that of its parent: subdirectories are still
+ * visited on every scan, using the cached list of their names.
  */
+typedef struct scan_dir {
+    struct scan_dir *next;          /* next sibling */
+    struct scan_dir *child;         /* first subdirectory */
+    FILETIME mtime;                 /* last write time when listed */
+    bool listed;                    /* listed and all configs found were readable */
+    wchar_t name[];                 /* directory name -- full path for roots */
+} scan_dir_t;
+
+static scan_dir_t *scan_roots;
+
+static scan_dir_t *
+NewScanDir(const wchar_t *name)
+{
+    size_t len = wcslen(name) + 1;
+    scan_dir_t *dir = calloc(1, sizeof(*dir) + len * sizeof(wchar_t));
+
+    if (!dir)
+    {
+        ErrorExit(1, L"Out of memory in NewScanDir");
+    }
+    memcpy(dir->name, name, len * sizeof(wchar_t));
+    return dir;
+}
+
 static void
-BuildFileList0(const TCHAR *config_dir, int recurse_depth, int group, int flags)
+FreeScanDirs(scan_dir_t *dir)
+{
+    while (dir)
+    {
+        scan_dir_t *next = dir->next;
+        FreeScanDirs(dir->child);
+        free(dir);
+        dir = next;
+    }
+}
+
+/*
+ * Unlink and return the entry with the given name from a list, or NULL
+ * if not found. Directory listings usually come in the same order each
+ * time, so the match is normally at the head of the list.
+ */
+static scan_dir_t *
+TakeScanDir(scan_dir_t **list, const wchar_t *name)
+{
+    for ( ; *list; list = &(*list)->next)
+    {
+        if (_wcsicmp((*list)->name, name) == 0)
+        {
+            scan_dir_t *dir = *list;
+            *list = dir->next;
+            dir->next = NULL;
+            return dir;
+        }
+    }
+    return NULL;
+}
+
+/*
+ * List config_dir once: add the configs found to group and replace the
+ * subdirectories of dir by those present now, retaining the cached state
+ * of the ones seen before. Subdirectories are not recorded if recurse_depth
+ * is less than 1.
+ * Returns false if the directory could not be listed or a config in it was
+ * not readable, so that it is listed again on the next scan.
+ */
+static bool
+ListConfigDir(const TCHAR *config_dir, scan_dir_t *dir, int recurse_depth, int group, int flags)
 {
     WIN32_FIND_DATA find_obj;
     HANDLE find_handle;
     TCHAR find_string[MAX_PATH];
-    TCHAR subdir_name[MAX_PATH];
+    scan_dir_t *old = dir->child;
+    scan_dir_t **tail = &dir->child;
+    bool complete = true;
+
+    dir->child = NULL;
 
     _sntprintf_0(find_string, _T("%ls\\*"), config_dir);
     find_handle = FindFirstFile(find_string, &find_obj);
     if (find_handle == INVALID_HANDLE_VALUE)
     {
-        return;
+        FreeScanDirs(old);
+        return false;
     }
 
-    /* Loop over each config file in config dir */
+    /* Loop over each config file and subdir in config dir */
     do
     {
         match_t match_type = match(&find_obj, o.ext_string);
@@ -329,41 +390,103 @@ BuildFileList0(const TCHAR *config_dir, int recurse_depth, int group, int flags)
             {
                 AddConfigFileToList(group, find_obj.cFileName, config_dir);
             }
+            else
+            {
+                complete = false;
+            }
+        }
+        else if (match_type == match_dir && recurse_depth >= 1)
+        {
+            if (wcscmp(find_obj.cFileName, _T("."))
+                &&  wcscmp(find_obj.cFileName, _T("..")))
+            {
+                scan_dir_t *sub = TakeScanDir(&old, find_obj.cFileName);
+                if (!sub)
+                {
+                    sub = NewScanDir(find_obj.cFileName);
+                }
+                *tail = sub;
+                tail = &sub->next;
+            }
         }
     } while (FindNextFile(find_handle, &find_obj));
 
     FindClose(find_handle);
 
-    /* optionally loop over each subdir */
-    if (recurse_depth < 1)
+    /* whatever is left has been removed from the directory */
+    FreeScanDirs(old);
+
+    return complete;
+}
+
+/* Scan for configs in config_dir recursing down up to recurse_depth.
+ * Input: config_dir -- root of the directory to scan from
+ *        dir        -- cached listing of config_dir
+ *        group      -- the group into which add the configs to
+ *        flags      -- enable warnings, use directory based
+ *                      grouping of configs etc.
+ * Currently configs in a directory are grouped together and group is
+ * the id of the current group in the global group array |o.groups|
+ * This may be recursively called until depth becomes 1 and each time
+ * the group is changed to that of the directory being recursed into.
+ * Directories unchanged since they were last listed are not listed again.
+ */
+static void
+BuildFileList0(const TCHAR *config_dir, scan_dir_t *dir, int recurse_depth, int group, int flags)
+{
+    WIN32_FILE_ATTRIBUTE_DATA attr;
+    TCHAR subdir_name[MAX_PATH];
+
+    if (!GetFileAttributesEx(config_dir, GetFileExInfoStandard, &attr))
     {
+        FreeScanDirs(dir->child);
+        dir->child = NULL;
+        dir->listed = false;
         return;
     }
 
-    find_handle = FindFirstFile(find_string, &find_obj);
-    if (find_handle == INVALID_HANDLE_VALUE)
+    /* time is read before listing so that changes made meanwhile are seen next time */
+    if (!dir->listed || CompareFileTime(&attr.ftLastWriteTime, &dir->mtime) != 0)
     {
-        return;
+        dir->mtime = attr.ftLastWriteTime;
+        dir->listed = ListConfigDir(config_dir, dir, recurse_depth, group, flags);
     }
 
-    do
+    /* loop over each subdir -- only recorded if recurse_depth >= 1 */
+    for (scan_dir_t *sub = dir->child; sub; sub = sub->next)
     {
-        match_t match_type = match(&find_obj, o.ext_string);
-        if (match_type == match_dir)
-        {
-            if (wcscmp(find_obj.cFileName, _T("."))
-                &&  wcscmp(find_obj.cFileName, _T("..")))
-            {
-                /* recurse into subdirectory */
-                _sntprintf_0(subdir_name, _T("%ls\\%ls"), config_dir, find_obj.cFileName);
-                int sub_group = NewConfigGroup(find_obj.cFileName, group, flags);
+        _sntprintf_0(subdir_name, _T("%ls\\%ls"), config_dir, sub->name);
+        int sub_group = NewConfigGroup(sub->name, group, flags);
 
-                BuildFileList0(subdir_name, recurse_depth - 1, sub_group, flags);
-            }
+        BuildFileList0(subdir_name, sub, recurse_depth - 1, sub_group, flags);
+    }
+}
+
+/*
+ * Scan a top level config directory using the listing cached by
+ * previous scans of the same path, if any.
+ */
+static void
+ScanConfigDir(const TCHAR *config_dir, int recurse_depth, int group, int flags)
+{
+    scan_dir_t *root;
+
+    for (root = scan_roots; root; root = root->next)
+    {
+        if (_wcsicmp(root->name, config_dir) == 0)
+        {
+            break;
         }
-    } while (FindNextFile(find_handle, &find_obj));
+    }
 
-    FindClose(find_handle);
+    if (!root)
+    {
+        root = NewScanDir(config_dir);
+        root->next = scan_roots;
+        scan_roots = root;
+    }
+
+    BuildFileList0(config_dir, root, recurse_depth, group, flags);
 }
 
 /*
@@ -450,6 +573,10 @@ BuildFileList()
     {
         o.num_groups = 0;
         flags |= FLAG_ADD_CONFIG_GROUPS;
+        /* a new list needs all directories listed */
+        FreeScanDirs(scan_roots);
+        scan_roots = NULL;
+
         root_gp = NewConfigGroup(L"ROOT", -1, flags); /* -1 indicates no parent */
         persistent_gp = NewConfigGroup(L"Persistent Profiles", root_gp, flags);
         system_gp = NewConfigGroup(L"System Profiles", root_gp, flags);
@@ -467,11 +594,11 @@ BuildFileList()
         flags |= FLAG_WARN_DUPLICATES | FLAG_WARN_MAX_CONFIGS;
     }
 
-    BuildFileList0(o.config_dir, recurse_depth, root_gp, flags);
+    ScanConfigDir(o.config_dir, recurse_depth, root_gp, flags);
 
     if (!IsSamePath(o.global_config_dir, o.config_dir))
     {
-        BuildFileList0(o.global_config_dir, recurse_depth, system_gp, flags);
+        ScanConfigDir(o.global_config_dir, recurse_depth, system_gp, flags);
     }
 
     if (o.service_state == service_connected
@@ -479,7 +606,7 @@ BuildFileList()
     {
         if (!IsSamePath(o.config_auto_dir, o.config_dir))
         {
-            BuildFileList0(o.config_auto_dir, recurse_depth, persistent_gp, flags);
+            ScanConfigDir(o.config_auto_dir, recurse_depth, persistent_gp, flags);
         }
     }
 
@@ -500,8 +627,13 @@ FreeConfigList(options_t *o)
     for (connection_t *c = o->chead; c; c = next)
     {
         next = c->next;
+        FreeManagementPassword(c);
         free(c);
     }
+    ClearConnIndex();
+    FreeScanDirs(scan_roots);
+    scan_roots = NULL;
+    o->chead = o->ctail = NULL;
     free(o->groups);
     o->groups = NULL;
     o->num_configs = 0;
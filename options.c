@@ -31,6 +31,8 @@
 #include <windowsx.h>
 #include <prsht.h>
 #include <stdlib.h>
+#include <stddef.h>
+#include <wctype.h>
 #include <malloc.h>
 #include <memory.h>
 #include <shlobj.h>
@@ -469,48 +471,190 @@ ProcessCommandLine(options_t *options, TCHAR *command_line)
 }
 
 
+/*
+ * Number of connections in each state. Connections change state from
+ * their own status threads as well as from the main thread, so the
+ * counters are only updated with interlocked operations.
+ */
+static volatile LONG conn_state_count[detached + 1];
+static volatile LONG conn_state_serial;
+
 /* Return num of connections with state = check */
 int
 CountConnState(conn_state_t check)
 {
-    int count = 0;
+    return (int) conn_state_count[check];
+}
+
+/*
+ * Set the state of a connection and update the per-state counters.
+ * Use this instead of assigning to c->state.
+ */
+void
+SetConnState(connection_t *c, conn_state_t state)
+{
+    conn_state_t old = (conn_state_t) InterlockedExchange((volatile LONG *) &c->state, (LONG) state);
 
-    for (connection_t *c = o.chead; c; c = c->next)
+    if (old != state)
     {
-        if (c->state == check)
+        InterlockedDecrement(&conn_state_count[old]);
+        InterlockedIncrement(&conn_state_count[state]);
+        InterlockedIncrement(&conn_state_serial);
+    }
+}
+
+/*
+ * Return a number that changes whenever any connection changes state.
+ * Lets callers skip recomputing data derived from connection states.
+ */
+LONG
+ConnStateSerial(void)
+{
+    return conn_state_serial;
+}
+
+/*
+ * Hash indexes of connections by case-insensitive config file and config
+ * name using open addressing. Entries are only ever added, as connections
+ * are not removed from the list except by FreeConfigList.
+ */
+typedef struct {
+    connection_t **slots;
+    size_t size;                      /* number of slots -- a power of 2 */
+    size_t count;                     /* number of slots in use */
+    size_t key_offset;                /* offset of the key in connection_t */
+} conn_index_t;
+
+static conn_index_t file_index = { .key_offset = offsetof(connection_t, config_file) };
+static conn_index_t name_index = { .key_offset = offsetof(connection_t, config_name) };
+
+#define CONN_INDEX_KEY(idx, c) ((const WCHAR *) ((const char *) (c) + (idx)->key_offset))
+
+static size_t
+HashName(const WCHAR *name)
+{
+    size_t h = 2166136261u; /* FNV-1a */
+    for ( ; *name; name++)
+    {
+        h = (h ^ towlower(*name)) * 16777619u;
+    }
+    return h;
+}
+
+/* Add c to the index unless a connection with the same key is present */
+static void
+ConnIndexInsert(conn_index_t *idx, connection_t *c)
+{
+    const WCHAR *key = CONN_INDEX_KEY(idx, c);
+    size_t i = HashName(key) & (idx->size - 1);
+
+    for ( ; idx->slots[i]; i = (i + 1) & (idx->size - 1))
+    {
+        if (wcsicmp(CONN_INDEX_KEY(idx, idx->slots[i]), key) == 0)
         {
-            ++count;
+            return;
         }
     }
-
-    return count;
+    idx->slots[i] = c;
+    idx->count++;
 }
 
-connection_t *
-GetConnByManagement(SOCKET sk)
+static connection_t *
+ConnIndexFind(const conn_index_t *idx, const WCHAR *key)
 {
-    for (connection_t *c = o.chead; c; c = c->next)
+    if (idx->count == 0)
     {
-        if (c->manage.sk == sk)
+        return NULL;
+    }
+
+    for (size_t i = HashName(key) & (idx->size - 1); idx->slots[i]; i = (i + 1) & (idx->size - 1))
+    {
+        if (wcsicmp(CONN_INDEX_KEY(idx, idx->slots[i]), key) == 0)
         {
-            return c;
+            return idx->slots[i];
         }
     }
     return NULL;
 }
 
-connection_t *
-GetConnByName(const WCHAR *name)
+/* Add a connection to the index, growing it to keep the load below 1/2 */
+static void
+ConnIndexAdd(conn_index_t *idx, connection_t *c)
 {
-    for (connection_t *c = o.chead; c; c = c->next)
+    if (2 * (idx->count + 1) > idx->size)
     {
-        if (wcsicmp(c->config_file, name) == 0
-            || wcsicmp(c->config_name, name) == 0)
+        size_t size = idx->size ? 2 * idx->size : 64;
+        connection_t **slots = calloc(size, sizeof(*slots));
+        if (!slots)
         {
-            return c;
+            ErrorExit(1, L"Out of memory in ConnIndexAdd");
+        }
+        free(idx->slots);
+        idx->slots = slots;
+        idx->size = size;
+        idx->count = 0;
+
+        /* reinsert in list order so that the first match is retained */
+        for (connection_t *ci = o.chead; ci; ci = ci->next)
+        {
+            if (ci != c)
+            {
+                ConnIndexInsert(idx, ci);
+            }
         }
     }
-    return NULL;
+    ConnIndexInsert(idx, c);
+}
+
+/*
+ * Add a connection to the lookup indexes. Call after config_file and
+ * config_name are set and the connection is linked to the list. The
+ * connection is also counted in its current state.
+ */
+void
+AddConnToIndex(connection_t *c)
+{
+    ConnIndexAdd(&file_index, c);
+    ConnIndexAdd(&name_index, c);
+    InterlockedIncrement(&conn_state_count[c->state]);
+    InterlockedIncrement(&conn_state_serial);
+}
+
+/* Empty the lookup indexes and reset the state counters */
+void
+ClearConnIndex(void)
+{
+    free(file_index.slots);
+    free(name_index.slots);
+    file_index.slots = name_index.slots = NULL;
+    file_index.size = name_index.size = 0;
+    file_index.count = name_index.count = 0;
+    for (size_t i = 0; i < _countof(conn_state_count); i++)
+    {
+        conn_state_count[i] = 0;
+    }
+    InterlockedIncrement(&conn_state_serial);
+}
+
+/* Find a connection by its config file name */
+connection_t *
+GetConnByFile(const WCHAR *config_file)
+{
+    return ConnIndexFind(&file_index, config_file);
+}
+
+connection_t *
+GetConnByName(const WCHAR *name)
+{
+    connection_t *c1 = ConnIndexFind(&file_index, name);
+    connection_t *c2 = ConnIndexFind(&name_index, name);
+
+    /* the first match in list order wins */
+    if (c1 && c2)
+    {
+        return (c1->id < c2->id) ? c1 : c2;
+    }
+    return c1 ? c1 : c2;
 }
 
 static BOOL
@@ -35,6 +35,7 @@ typedef struct connection connection_t;
 #include "manage.h"
 #include "echo.h"
 #include "pkcs11.h"
+#include "statuslog.h"
 
 #define MAX_NAME (UNLEN + 1)
 
@@ -147,10 +148,10 @@ struct connection {
         SOCKET sk;
         SOCKADDR_IN skaddr;
         time_t timeout;
-        char password[4096];        /* match with largest possible passwd in openvpn.exe */
-        char *saved_data;
-        size_t saved_size;
-        mgmt_cmd_t *cmd_queue;
+        char *password;             /* MGMT_PASSWORD_SIZE bytes, allocated only until used */
+        mgmt_rbuf_t rbuf;
+        mgmt_cmd_queue_t cmds;
+        BOOL send_pending;          /* a deferred SendCommand has been posted */
         DWORD connected;             /* 1: management interface connected, 2: connected and ready */
     } manage;
 
@@ -167,6 +168,7 @@ struct connection {
     struct env_item *es;           /* Pointer to the head of config-specific env variables list */
     struct echo_msg echo_msg;      /* Message echo-ed from server or client config and related data */
     struct pkcs11_list pkcs11_list;
+    status_log_t log;              /* Lines waiting to be added to the status window log */
     char daemon_state[20];         /* state of openvpn.ex: WAIT, AUTH, GET_CONFIG etc.. */
     int id;                        /* index of config -- treat as immutable once assigned */
     connection_t *next;
@@ -255,10 +257,18 @@ void ProcessCommandLine(options_t *, TCHAR *);
 
 int CountConnState(conn_state_t);
 
-connection_t *GetConnByManagement(SOCKET);
+void SetConnState(connection_t *c, conn_state_t state);
+
+LONG ConnStateSerial(void);
 
 connection_t *GetConnByName(const WCHAR *config_name);
 
+connection_t *GetConnByFile(const WCHAR *config_file);
+
+void AddConnToIndex(connection_t *c);
+
+void ClearConnIndex(void);
+
 INT_PTR CALLBACK ScriptSettingsDlgProc(HWND hwndDlg, UINT msg, WPARAM wParam, LPARAM lParam);
 
 INT_PTR CALLBACK ConnectionSettingsDlgProc(HWND hwndDlg, UINT msg, WPARAM wParam, LPARAM lParam);
@@ -28,6 +28,7 @@
 #include <credentialprovider.h>
 #include "plap_common.h"
 #include "plap_dll.h"
+#include "localization.h"
 
 static LONG dll_ref_count = 0;
 
@@ -50,6 +51,7 @@ DllMain(HINSTANCE hinstDll, DWORD dwReason, UNUSED LPVOID pReserved)
             break;
 
         case DLL_PROCESS_DETACH:
+            FreeLocalizedStringBuffers();
             uninit_debug();
             break;
 
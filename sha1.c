@@ -0,0 +1,157 @@
+/*
+ *  OpenVPN-GUI -- A Windows GUI for OpenVPN.
+ *
+ *  Copyright (C) 2026 agent <agent@local>
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program (see the file COPYING included with this
+ *  distribution); if not, write to the Free Software Foundation, Inc.,
+ *  59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+#ifdef HAVE_CONFIG_H
+#include <config.h>
+#endif
+
+#include <string.h>
+
+#include "sha1.h"
+
+#define ROL(x, n) (((x) << (n)) | ((x) >> (32 - (n))))
+
+/* Process one 64 byte block */
+static void
+sha1_block(uint32_t h[5], const unsigned char *p)
+{
+    uint32_t w[80];
+    uint32_t a = h[0], b = h[1], c = h[2], d = h[3], e = h[4];
+
+    for (int i = 0; i < 16; i++)
+    {
+        w[i] = (uint32_t) p[4*i] << 24 | (uint32_t) p[4*i + 1] << 16
+               | (uint32_t) p[4*i + 2] << 8 | (uint32_t) p[4*i + 3];
+    }
+    for (int i = 16; i < 80; i++)
+    {
+        w[i] = ROL(w[i-3] ^ w[i-8] ^ w[i-14] ^ w[i-16], 1);
+    }
+
+    for (int i = 0; i < 80; i++)
+    {
+        uint32_t f, k;
+        if (i < 20)
+        {
+            f = (b & c) | (~b & d);
+            k = 0x5A827999;
+        }
+        else if (i < 40)
+        {
+            f = b ^ c ^ d;
+            k = 0x6ED9EBA1;
+        }
+        else if (i < 60)
+        {
+            f = (b & c) | (b & d) | (c & d);
+            k = 0x8F1BBCDC;
+        }
+        else
+        {
+            f = b ^ c ^ d;
+            k = 0xCA62C1D6;
+        }
+        uint32_t t = ROL(a, 5) + f + e + k + w[i];
+        e = d;
+        d = c;
+        c = ROL(b, 30);
+        b = a;
+        a = t;
+    }
+
+    h[0] += a;
+    h[1] += b;
+    h[2] += c;
+    h[3] += d;
+    h[4] += e;
+}
+
+void
+sha1_init(sha1_ctx *ctx)
+{
+    ctx->h[0] = 0x67452301;
+    ctx->h[1] = 0xEFCDAB89;
+    ctx->h[2] = 0x98BADCFE;
+    ctx->h[3] = 0x10325476;
+    ctx->h[4] = 0xC3D2E1F0;
+    ctx->len = 0;
+}
+
+void
+sha1_update(sha1_ctx *ctx, const void *data, size_t len)
+{
+    const unsigned char *p = data;
+    size_t used = (size_t) (ctx->len % 64);
+
+    ctx->len += len;
+
+    /* complete a partial block first */
+    if (used)
+    {
+        size_t n = 64 - used;
+        if (len < n)
+        {
+            memcpy(ctx->buf + used, p, len);
+            return;
+        }
+        memcpy(ctx->buf + used, p, n);
+        sha1_block(ctx->h, ctx->buf);
+        p += n;
+        len -= n;
+    }
+
+    for ( ; len >= 64; p += 64, len -= 64)
+    {
+        sha1_block(ctx->h, p);
+    }
+    memcpy(ctx->buf, p, len);
+}
+
+void
+sha1_final(sha1_ctx *ctx, unsigned char md[SHA1_DIGEST_SIZE])
+{
+    uint64_t bits = ctx->len * 8;
+    size_t used = (size_t) (ctx->len % 64);
+
+    /* pad with 0x80, zeros and the message length in bits */
+    ctx->buf[used++] = 0x80;
+    if (used > 56)
+    {
+        memset(ctx->buf + used, 0, 64 - used);
+        sha1_block(ctx->h, ctx->buf);
+        used = 0;
+    }
+    memset(ctx->buf + used, 0, 56 - used);
+    for (int i = 0; i < 8; i++)
+    {
+        ctx->buf[56 + i] = (unsigned char) (bits >> (56 - 8*i));
+    }
+    sha1_block(ctx->h, ctx->buf);
+
+    for (int i = 0; i < 5; i++)
+    {
+        md[4*i] = (unsigned char) (ctx->h[i] >> 24);
+        md[4*i + 1] = (unsigned char) (ctx->h[i] >> 16);
+        md[4*i + 2] = (unsigned char) (ctx->h[i] >> 8);
+        md[4*i + 3] = (unsigned char) ctx->h[i];
+    }
+    sha1_init(ctx);
+}
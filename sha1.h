@@ -0,0 +1,48 @@
+/*
+ *  OpenVPN-GUI -- A Windows GUI for OpenVPN.
+ *
+ *  Copyright (C) 2026 agent <agent@local>
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program (see the file COPYING included with this
+ *  distribution); if not, write to the Free Software Foundation, Inc.,
+ *  59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+#ifndef SHA1_H
+#define SHA1_H
+
+/*
+ * SHA-1 message digest (FIPS 180-4) computed incrementally. Used to
+ * fingerprint messages, not for security. Only the C library is used.
+ */
+
+#include <stddef.h>
+#include <stdint.h>
+
+#define SHA1_DIGEST_SIZE 20
+
+typedef struct {
+    uint32_t h[5];                  /* intermediate hash state */
+    uint64_t len;                   /* number of bytes hashed so far */
+    unsigned char buf[64];          /* partial block */
+} sha1_ctx;
+
+void sha1_init(sha1_ctx *ctx);
+
+void sha1_update(sha1_ctx *ctx, const void *data, size_t len);
+
+/* Write the digest of all data added to md and reset ctx */
+void sha1_final(sha1_ctx *ctx, unsigned char md[SHA1_DIGEST_SIZE]);
+
+#endif /* ifndef SHA1_H */
@@ -0,0 +1,262 @@
+/*
+ *  OpenVPN-GUI -- A Windows GUI for OpenVPN.
+ *
+ *  Copyright (C) 2004 Mathias Sundman <mathias@nilings.se>
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program (see the file COPYING included with this
+ *  distribution); if not, write to the Free Software Foundation, Inc.,
+ *  59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+#ifdef HAVE_CONFIG_H
+#include <config.h>
+#endif
+
+#include <windows.h>
+#include <richedit.h>
+
+#include "main.h"
+#include "options.h"
+#include "statuslog.h"
+#include "openvpn-gui-res.h"
+
+#define LOG_FLUSH_DELAY 50      /* milliseconds to wait for more lines before display */
+#define LOG_FLUSH_LINES 64      /* number of pending lines that forces display */
+
+/*
+ * Make room for n more bytes plus a terminating nul in the pending text.
+ * Returns FALSE if out of memory.
+ */
+static BOOL
+ReserveText(status_log_t *log, size_t n)
+{
+    if (log->len + n < log->size)
+    {
+        return TRUE;
+    }
+
+    size_t size = max(max(2 * log->size, log->len + n + 1), 4096);
+    char *text = realloc(log->text, size);
+    if (!text)
+    {
+        return FALSE;
+    }
+    log->text = text;
+    log->size = size;
+    return TRUE;
+}
+
+/*
+ * Format t as local time in the style of ctime(). Log lines arrive in bursts
+ * with the same or increasing time, so while t falls in the same minute as
+ * the previous call only the seconds are patched into the cached text in lt.
+ * localtime_s() is used, so threads do not share the static buffer of ctime().
+ * The cache in c->log is used only on the thread that owns the status window;
+ * others pass a cache of their own.
+ */
+const char *
+StatusLogTime(log_time_t *lt, time_t t)
+{
+    static const char day[7][4] = { "Sun", "Mon", "Tue", "Wed", "Thu", "Fri", "Sat" };
+    static const char month[12][4] = { "Jan", "Feb", "Mar", "Apr", "May", "Jun",
+                                       "Jul", "Aug", "Sep", "Oct", "Nov", "Dec" };
+    struct tm tm;
+
+    if (lt->valid && t >= lt->minute && t - lt->minute < 60)
+    {
+        int sec = (int) (t - lt->minute);
+        lt->text[17] = '0' + sec / 10;
+        lt->text[18] = '0' + sec % 10;
+        return lt->text;
+    }
+
+    if (localtime_s(&tm, &t) != 0)
+    {
+        lt->valid = FALSE;
+        _snprintf_0(lt->text, "%lld ", (long long) t);
+        return lt->text;
+    }
+
+    _snprintf_0(lt->text, "%s %s %02d %02d:%02d:%02d %d ", day[tm.tm_wday], month[tm.tm_mon],
+                tm.tm_mday, tm.tm_hour, tm.tm_min, tm.tm_sec, tm.tm_year + 1900);
+    lt->minute = t - tm.tm_sec;
+    /* seconds are at a fixed position only for 4 digit years */
+    lt->valid = (strlen(lt->text) == 25);
+
+    return lt->text;
+}
+
+void
+StatusLogBegin(connection_t *c, COLORREF color)
+{
+    status_log_t *log = &c->log;
+
+    log->start = log->len;
+    log->dropped = FALSE;
+
+    /* nothing to display the line in */
+    if (!c->hwndStatus)
+    {
+        log->dropped = TRUE;
+        return;
+    }
+
+    if (log->count == log->max)
+    {
+        int max = log->max ? 2 * log->max : LOG_FLUSH_LINES;
+        status_log_line_t *lines = realloc(log->lines, max * sizeof(*lines));
+        if (!lines)
+        {
+            log->dropped = TRUE;
+            return;
+        }
+        log->lines = lines;
+        log->max = max;
+    }
+
+    log->lines[log->count].offset = log->start;
+    log->lines[log->count].color = color;
+}
+
+void
+StatusLogAppendA(connection_t *c, const char *str)
+{
+    status_log_t *log = &c->log;
+    size_t n = strlen(str);
+
+    if (log->dropped || !ReserveText(log, n))
+    {
+        log->dropped = TRUE;
+        return;
+    }
+    memcpy(log->text + log->len, str, n);
+    log->len += n;
+}
+
+void
+StatusLogAppendW(connection_t *c, const wchar_t *str)
+{
+    status_log_t *log = &c->log;
+
+    /* n includes the terminating nul */
+    int n = WideCharToMultiByte(CP_UTF8, 0, str, -1, NULL, 0, NULL, NULL);
+    if (n <= 1 || log->dropped)
+    {
+        return;
+    }
+    if (!ReserveText(log, n))
+    {
+        log->dropped = TRUE;
+        return;
+    }
+    WideCharToMultiByte(CP_UTF8, 0, str, -1, log->text + log->len, n, NULL, NULL);
+    log->len += n - 1;
+}
+
+void
+StatusLogEnd(connection_t *c)
+{
+    status_log_t *log = &c->log;
+
+    StatusLogAppendA(c, "\n");
+    if (log->dropped)
+    {
+        log->len = log->start;
+        return;
+    }
+
+    if (++log->count >= LOG_FLUSH_LINES)
+    {
+        StatusLogFlush(c);
+    }
+    else if (log->count == 1)
+    {
+        SetTimer(c->hwndStatus, IDT_LOG_FLUSH_TIMER, LOG_FLUSH_DELAY, NULL);
+    }
+}
+
+/*
+ * Append pending lines to the log window: lines of the same color are
+ * added with a single message, and old lines are removed and the view
+ * scrolled only once per batch.
+ */
+void
+StatusLogFlush(connection_t *c)
+{
+    status_log_t *log = &c->log;
+    const SETTEXTEX ste = {
+        .flags = ST_SELECTION,
+        .codepage = CP_UTF8
+    };
+
+    KillTimer(c->hwndStatus, IDT_LOG_FLUSH_TIMER);
+    if (log->count == 0)
+    {
+        return;
+    }
+
+    HWND logWnd = GetDlgItem(c->hwndStatus, ID_EDT_LOG);
+
+    /* Remove lines from log window if it is getting full */
+    int lines = (int) SendMessage(logWnd, EM_GETLINECOUNT, 0, 0);
+    if (lines + log->count > MAX_LOG_LINES)
+    {
+        /* pos is -1, selecting all text, if fewer lines are present */
+        int pos = (int) SendMessage(logWnd, EM_LINEINDEX,
+                                    lines + log->count - MAX_LOG_LINES + DEL_LOG_LINES, 0);
+        SendMessage(logWnd, EM_SETSEL, 0, pos);
+        SendMessage(logWnd, EM_REPLACESEL, FALSE, (LPARAM) L"");
+    }
+
+    /* deselect current selection, if any */
+    SendMessage(logWnd, EM_SETSEL, (WPARAM) -1, (LPARAM) -1);
+
+    for (int i = 0, j; i < log->count; i = j)
+    {
+        COLORREF color = log->lines[i].color;
+        for (j = i + 1; j < log->count && log->lines[j].color == color; j++)
+        {
+        }
+        size_t end = (j < log->count) ? log->lines[j].offset : log->len;
+
+        /* change text color if Warning or Error */
+        CHARFORMAT cfm = { .cbSize = sizeof(CHARFORMAT),
+                           .dwMask = CFM_COLOR|CFM_BOLD,
+                           .dwEffects = color ? 0 : CFE_AUTOCOLOR,
+                           .crTextColor = color, };
+        SendMessage(logWnd, EM_SETCHARFORMAT, SCF_SELECTION, (LPARAM) &cfm);
+
+        /* terminate the run in place -- text always has room past len */
+        char saved = log->text[end];
+        log->text[end] = '\0';
+        SendMessage(logWnd, EM_SETTEXTEX, (WPARAM) &ste, (LPARAM) (log->text + log->lines[i].offset));
+        log->text[end] = saved;
+    }
+
+    /* scroll to the caret */
+    SendMessage(logWnd, EM_SCROLLCARET, 0, 0);
+
+    log->count = 0;
+    log->len = 0;
+}
+
+void
+StatusLogFree(connection_t *c)
+{
+    status_log_t *log = &c->log;
+
+    free(log->text);
+    free(log->lines);
+    CLEAR(*log);
+}
@@ -0,0 +1,83 @@
+/*
+ *  OpenVPN-GUI -- A Windows GUI for OpenVPN.
+ *
+ *  Copyright (C) 2004 Mathias Sundman <mathias@nilings.se>
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program (see the file COPYING included with this
+ *  distribution); if not, write to the Free Software Foundation, Inc.,
+ *  59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+#ifndef STATUSLOG_H
+#define STATUSLOG_H
+
+#include <windows.h>
+#include <time.h>
+
+/* A line waiting to be added to the status window log */
+typedef struct {
+    size_t offset;                  /* start of the line in the pending text */
+    COLORREF color;                 /* text color, 0 for the default */
+} status_log_line_t;
+
+/*
+ * Last timestamp rendered for the log in the format of ctime(), without
+ * the trailing newline: "Wed Jan 02 02:03:55 1980 ".
+ */
+typedef struct {
+    BOOL valid;
+    time_t minute;                  /* start of the local time minute in text */
+    char text[32];
+} log_time_t;
+
+/*
+ * Lines written to the status window log are collected here and added to
+ * the log window in batches, either when LOG_FLUSH_LINES are pending or
+ * when IDT_LOG_FLUSH_TIMER expires. Only the thread that owns the status
+ * window may use these: WriteStatusLog passes lines from other threads to it.
+ */
+typedef struct {
+    char *text;                     /* pending lines in UTF-8, each ending in a newline */
+    size_t len;
+    size_t size;
+    size_t start;                   /* offset of the line being added */
+    BOOL dropped;                   /* the line being added is discarded */
+    status_log_line_t *lines;
+    int count;
+    int max;
+    log_time_t time;                /* time cache for StatusLogTime */
+} status_log_t;
+
+/* Format a timestamp for the log, reusing the text of the previous call when possible */
+const char *StatusLogTime(log_time_t *lt, time_t t);
+
+/* Start a new line of the given color -- add text and finish with StatusLogEnd */
+void StatusLogBegin(connection_t *c, COLORREF color);
+
+/* Add UTF-8 text to the current line */
+void StatusLogAppendA(connection_t *c, const char *str);
+
+/* Add wide char text to the current line */
+void StatusLogAppendW(connection_t *c, const wchar_t *str);
+
+/* Finish the current line and schedule it for display */
+void StatusLogEnd(connection_t *c);
+
+/* Add all pending lines to the log window */
+void StatusLogFlush(connection_t *c);
+
+/* Discard pending lines and free the buffers */
+void StatusLogFree(connection_t *c);
+
+#endif /* ifndef STATUSLOG_H */
@@ -0,0 +1,56 @@
+/*
+ *  OpenVPN-GUI -- A Windows GUI for OpenVPN.
+ *
+ *  Copyright (C) 2026 agent <agent@local>
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program (see the file COPYING included with this
+ *  distribution); if not, write to the Free Software Foundation, Inc.,
+ *  59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+#ifndef TEST_H
+#define TEST_H
+
+/*
+ * Minimal unit test support: CHECK() reports a failed condition and
+ * test_result() turns the failure count into the exit status.
+ */
+
+#include <stdio.h>
+
+static int test_failures;
+
+#define CHECK(cond)                                                   \
+    do {                                                              \
+        if (!(cond))                                                  \
+        {                                                             \
+            fprintf(stderr, "%s:%d: check failed: %s\n",              \
+                    __FILE__, __LINE__, #cond);                       \
+            test_failures++;                                          \
+        }                                                             \
+    } while (0)
+
+static int
+test_result(const char *name)
+{
+    if (test_failures)
+    {
+        fprintf(stderr, "%s: %d check(s) failed\n", name, test_failures);
+        return 1;
+    }
+    printf("%s: all checks passed\n", name);
+    return 0;
+}
+
+#endif /* ifndef TEST_H */
@@ -0,0 +1,221 @@
+/*
+ *  OpenVPN-GUI -- A Windows GUI for OpenVPN.
+ *
+ *  Copyright (C) 2026 agent <agent@local>
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program (see the file COPYING included with this
+ *  distribution); if not, write to the Free Software Foundation, Inc.,
+ *  59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+#include <stdlib.h>
+#include <string.h>
+
+#include "codec.h"
+#include "test.h"
+
+static int
+decode_str(const char *in, void *out, size_t size)
+{
+    return base64_decode(in, strlen(in), out, size);
+}
+
+static void
+test_base64(void)
+{
+    char enc[64];
+    char dec[64];
+
+    CHECK(base64_encode("", 0, enc, sizeof(enc)) == 0 && enc[0] == '\0');
+    CHECK(base64_encode("f", 1, enc, sizeof(enc)) == 4 && strcmp(enc, "Zg==") == 0);
+    CHECK(base64_encode("fo", 2, enc, sizeof(enc)) == 4 && strcmp(enc, "Zm8=") == 0);
+    CHECK(base64_encode("foobar", 6, enc, sizeof(enc)) == 8 && strcmp(enc, "Zm9vYmFy") == 0);
+
+    /* the output must have room for the nul terminator */
+    CHECK(base64_encode("foo", 3, enc, 4) == -1);
+    CHECK(base64_encode("foo", 3, enc, 5) == 4);
+
+    CHECK(decode_str("Zm9vYg==", dec, sizeof(dec)) == 4 && memcmp(dec, "foob", 4) == 0);
+    CHECK(decode_str("Zm9vYg", dec, sizeof(dec)) == 4);     /* padding is optional */
+    CHECK(decode_str(" Zm9v\r\nYg==\n", dec, sizeof(dec)) == 4);
+    CHECK(decode_str("", dec, sizeof(dec)) == 0);
+
+    /* embedded nul bytes survive */
+    CHECK(base64_encode("a\0b\0", 4, enc, sizeof(enc)) == 8 && strcmp(enc, "YQBiAA==") == 0);
+    CHECK(decode_str(enc, dec, sizeof(dec)) == 4 && memcmp(dec, "a\0b\0", 4) == 0);
+
+    /* output too small */
+    CHECK(decode_str("Zm9vYmFy", dec, 5) == -1);
+    CHECK(decode_str("Zm9vYmFy", dec, 6) == 6);
+}
+
+/* Malformed base64 input is rejected */
+static void
+test_base64_invalid(void)
+{
+    char dec[64];
+    const char *invalid[] = {
+        "Z",            /* a single digit left over */
+        "Zm9vY",
+        "Z===",
+        "Zg===",        /* too much padding */
+        "Zg=g",         /* data after padding */
+        "=Zg",
+        "Zg==Zg==",
+        "Zm9v!",        /* not base64 digits */
+        "Zm-_",
+        "Zm\x80v",
+    };
+
+    for (size_t i = 0; i < sizeof(invalid) / sizeof(invalid[0]); i++)
+    {
+        CHECK(decode_str(invalid[i], dec, sizeof(dec)) == -1);
+    }
+
+    /* an embedded nul is not a base64 digit */
+    CHECK(base64_decode("Zg\0=", 4, dec, sizeof(dec)) == -1);
+}
+
+/* Random data of random length survives encoding and decoding */
+static void
+test_base64_random(void)
+{
+    unsigned char data[300];
+    char enc[BASE64_ENCODE_SIZE(300)];
+
+    srand(1);
+    for (int round = 0; round < 10000; round++)
+    {
+        size_t len = rand() % (sizeof(data) + 1);
+        for (size_t i = 0; i < len; i++)
+        {
+            /* plenty of nul bytes */
+            data[i] = (rand() % 4) ? (unsigned char) rand() : 0;
+        }
+
+        int n = base64_encode(data, len, enc, BASE64_ENCODE_SIZE(len));
+        CHECK(n >= 0 && (size_t) n == BASE64_ENCODE_SIZE(len) - 1 && strlen(enc) == (size_t) n);
+
+        /* the decoder must not write past the size it is given */
+        size_t size = BASE64_DECODE_SIZE(n);
+        unsigned char *out = malloc(size);
+        int m = base64_decode(enc, n, out, size);
+        CHECK(m >= 0 && (size_t) m == len && memcmp(out, data, len) == 0);
+        free(out);
+
+        /* exactly len bytes of output are enough */
+        out = malloc(len ? len : 1);
+        CHECK(base64_decode(enc, n, out, len) == (int) len);
+        free(out);
+
+        /* random garbage is decoded or rejected, never overruns out */
+        for (int i = 0; i < n; i++)
+        {
+            enc[i] = (char) (rand() % 256);
+        }
+        size = rand() % 8;
+        out = malloc(size ? size : 1);
+        m = base64_decode(enc, n, out, size);
+        CHECK(m >= -1 && m <= (int) size);
+        free(out);
+    }
+}
+
+static void
+test_url_decode(void)
+{
+    const char *s = "a%41%62%2f%2F+%20";
+    const char *expected = "aAb//+ ";
+
+    for (size_t i = 0; i < strlen(expected); i++)
+    {
+        CHECK(url_decode_char(&s) == (unsigned char) expected[i]);
+    }
+    CHECK(*s == '\0');
+
+    /* an encoded nul is decoded as such and skipped */
+    s = "%00x";
+    CHECK(url_decode_char(&s) == 0 && strcmp(s, "x") == 0);
+
+    /* truncated or invalid escapes pass the % through without reading past the end */
+    s = "%";
+    CHECK(url_decode_char(&s) == '%' && *s == '\0');
+    s = "%4";
+    CHECK(url_decode_char(&s) == '%' && strcmp(s, "4") == 0);
+    CHECK(url_decode_char(&s) == '4' && *s == '\0');
+    s = "%4g";
+    CHECK(url_decode_char(&s) == '%' && strcmp(s, "4g") == 0);
+    s = "%%41";
+    CHECK(url_decode_char(&s) == '%' && url_decode_char(&s) == 'A' && *s == '\0');
+    s = "%\xff\xff";
+    CHECK(url_decode_char(&s) == '%' && url_decode_char(&s) == 0xff);
+}
+
+/* Random bytes survive url encoding with a mix of escapes */
+static void
+test_url_decode_random(void)
+{
+    static const char hex[] = "0123456789abcdef0123456789ABCDEF";
+    unsigned char data[100];
+    char enc[3 * sizeof(data) + 1];
+
+    srand(2);
+    for (int round = 0; round < 10000; round++)
+    {
+        size_t len = rand() % (sizeof(data) + 1);
+        char *e = enc;
+
+        for (size_t i = 0; i < len; i++)
+        {
+            data[i] = (unsigned char) (1 + rand() % 255);
+            if (data[i] == '%' || rand() % 2)
+            {
+                int upper = (rand() % 2) * 16;
+                *e++ = '%';
+                *e++ = hex[(data[i] >> 4) + upper];
+                *e++ = hex[(data[i] & 0xf) + upper];
+            }
+            else
+            {
+                *e++ = (char) data[i];
+            }
+        }
+        *e = '\0';
+
+        /* decode from an exact size copy so that overreads are caught */
+        char *copy = malloc(e - enc + 1);
+        memcpy(copy, enc, e - enc + 1);
+        const char *s = copy;
+        size_t n = 0;
+        while (*s && n < len)
+        {
+            CHECK(url_decode_char(&s) == data[n]);
+            n++;
+        }
+        CHECK(n == len && *s == '\0');
+        free(copy);
+    }
+}
+
+int
+main(void)
+{
+    test_base64();
+    test_base64_invalid();
+    test_base64_random();
+    test_url_decode();
+    test_url_decode_random();
+
+    return test_result("test_codec");
+}
@@ -0,0 +1,308 @@
+/*
+ *  OpenVPN-GUI -- A Windows GUI for OpenVPN.
+ *
+ *  Copyright (C) 2026 agent <agent@local>
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program (see the file COPYING included with this
+ *  distribution); if not, write to the Free Software Foundation, Inc.,
+ *  59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+#include <stdlib.h>
+#include <string.h>
+
+#include "echo_history.h"
+#include "test.h"
+
+/* A fingerprint with id in its digest that hashes to the given slot */
+static struct echo_msg_fp
+make_fp(int slot, int id, time_t timestamp)
+{
+    struct echo_msg_fp fp;
+
+    memset(&fp, 0, sizeof(fp));
+    fp.digest[0] = slot & 0xff;
+    fp.digest[1] = (slot >> 8) & 0xff;
+    fp.digest[2] = id & 0xff;
+    fp.digest[3] = (id >> 8) & 0xff;
+    fp.timestamp = timestamp;
+    return fp;
+}
+
+static int
+has(const struct echo_msg_history *hist, const struct echo_msg_fp *fp)
+{
+    int n = echo_msg_history_find(hist, fp->digest);
+    return n >= 0 && memcmp(hist->fp[n].digest, fp->digest, HASHLEN) == 0;
+}
+
+/* Check that the items in history are listed in order of the given ids */
+static int
+order_is(const struct echo_msg_history *hist, const int *ids, int len)
+{
+    struct echo_msg_fp list[ECHO_MSG_HISTORY_MAX];
+
+    if ((int) echo_msg_history_list(hist, list) != len || hist->count != len)
+    {
+        return 0;
+    }
+    for (int i = 0; i < len; i++)
+    {
+        if ((list[i].digest[2] | list[i].digest[3] << 8) != ids[i])
+        {
+            return 0;
+        }
+    }
+    return 1;
+}
+
+static void
+test_insert_lookup_delete(void)
+{
+    struct echo_msg_history *hist = echo_msg_history_new();
+    struct echo_msg_fp a = make_fp(10, 1, 100);
+    struct echo_msg_fp b = make_fp(10, 2, 101); /* collides with a */
+    struct echo_msg_fp c = make_fp(11, 3, 102); /* probes past b */
+    struct echo_msg_fp d = make_fp(40, 4, 103);
+
+    CHECK(echo_msg_history_find(NULL, a.digest) == -1);
+    CHECK(echo_msg_history_find(hist, a.digest) == -1);
+
+    echo_msg_history_add(hist, &a);
+    echo_msg_history_add(hist, &b);
+    echo_msg_history_add(hist, &c);
+    CHECK(hist->count == 3);
+    CHECK(has(hist, &a) && has(hist, &b) && has(hist, &c));
+    CHECK(!has(hist, &d));
+
+    /* deleting the head of a probe sequence keeps the rest reachable */
+    echo_msg_history_remove(hist, echo_msg_history_find(hist, a.digest));
+    CHECK(hist->count == 2);
+    CHECK(!has(hist, &a) && has(hist, &b) && has(hist, &c));
+
+    echo_msg_history_add(hist, &d);
+    echo_msg_history_remove(hist, echo_msg_history_find(hist, b.digest));
+    CHECK(!has(hist, &b) && has(hist, &c) && has(hist, &d));
+    CHECK(order_is(hist, (int[]) {4, 3}, 2));
+
+    echo_msg_history_remove(hist, echo_msg_history_find(hist, c.digest));
+    echo_msg_history_remove(hist, echo_msg_history_find(hist, d.digest));
+    CHECK(hist->count == 0 && hist->newest == -1 && hist->oldest == -1);
+    for (int i = 0; i < ECHO_MSG_HISTORY_SLOTS; i++)
+    {
+        CHECK(hist->slots[i] == 0);
+    }
+
+    /* saving an item again updates its timestamp only */
+    echo_msg_history_save(hist, &a);
+    a.timestamp = 200;
+    echo_msg_history_save(hist, &a);
+    CHECK(hist->count == 1);
+    CHECK(hist->fp[echo_msg_history_find(hist, a.digest)].timestamp == 200);
+
+    free(hist);
+}
+
+/* Probe sequences wrap around the end of the slot table */
+static void
+test_wraparound(void)
+{
+    struct echo_msg_history *hist = echo_msg_history_new();
+    const int last = ECHO_MSG_HISTORY_SLOTS - 1;
+    struct echo_msg_fp fp[5];
+
+    fp[0] = make_fp(last - 1, 1, 1);
+    fp[1] = make_fp(last, 2, 2);
+    fp[2] = make_fp(last, 3, 3);
+    fp[3] = make_fp(last - 1, 4, 4);
+    fp[4] = make_fp(0, 5, 5); /* its home slot is taken by a wrapped item */
+    for (int i = 0; i < 5; i++)
+    {
+        echo_msg_history_add(hist, &fp[i]);
+    }
+    CHECK(hist->slots[0] && hist->slots[1] && hist->slots[2]);
+    for (int i = 0; i < 5; i++)
+    {
+        CHECK(has(hist, &fp[i]));
+    }
+
+    /* removing before the wrap moves items back across it */
+    echo_msg_history_remove(hist, echo_msg_history_find(hist, fp[1].digest));
+    CHECK(!has(hist, &fp[1]));
+    CHECK(has(hist, &fp[0]) && has(hist, &fp[2]) && has(hist, &fp[3]) && has(hist, &fp[4]));
+    CHECK(hist->slots[2] == 0);
+
+    echo_msg_history_remove(hist, echo_msg_history_find(hist, fp[0].digest));
+    CHECK(has(hist, &fp[2]) && has(hist, &fp[3]) && has(hist, &fp[4]));
+    CHECK(order_is(hist, (int[]) {5, 4, 3}, 3));
+
+    free(hist);
+}
+
+/* The least recently saved item is evicted when full */
+static void
+test_eviction(void)
+{
+    struct echo_msg_history *hist = echo_msg_history_new();
+    struct echo_msg_fp fp[ECHO_MSG_HISTORY_MAX + 2];
+
+    for (int i = 0; i < ECHO_MSG_HISTORY_MAX + 2; i++)
+    {
+        fp[i] = make_fp(i * 7, i, 1000 + i);
+    }
+    for (int i = 0; i < ECHO_MSG_HISTORY_MAX; i++)
+    {
+        echo_msg_history_save(hist, &fp[i]);
+    }
+    CHECK(hist->count == ECHO_MSG_HISTORY_MAX);
+
+    echo_msg_history_save(hist, &fp[ECHO_MSG_HISTORY_MAX]);
+    CHECK(hist->count == ECHO_MSG_HISTORY_MAX);
+    CHECK(!has(hist, &fp[0]));
+    CHECK(has(hist, &fp[1]) && has(hist, &fp[ECHO_MSG_HISTORY_MAX]));
+
+    /* showing an item again protects it from eviction */
+    echo_msg_history_save(hist, &fp[1]);
+    echo_msg_history_save(hist, &fp[ECHO_MSG_HISTORY_MAX + 1]);
+    CHECK(has(hist, &fp[1]) && !has(hist, &fp[2]) && has(hist, &fp[3]));
+    CHECK(hist->count == ECHO_MSG_HISTORY_MAX);
+
+    free(hist);
+}
+
+static void
+test_expiry(void)
+{
+    struct echo_msg_history *hist = echo_msg_history_new();
+    struct echo_msg_fp fp[4];
+
+    for (int i = 0; i < 4; i++)
+    {
+        fp[i] = make_fp(i, i, 10 + i);
+        echo_msg_history_save(hist, &fp[i]);
+    }
+    /* re-shown item is expired by its latest timestamp */
+    fp[0].timestamp = 20;
+    echo_msg_history_save(hist, &fp[0]);
+
+    echo_msg_history_expire(hist, 9);
+    CHECK(hist->count == 4);
+    echo_msg_history_expire(hist, 12);
+    CHECK(hist->count == 2);
+    CHECK(has(hist, &fp[0]) && has(hist, &fp[3]));
+    CHECK(!has(hist, &fp[1]) && !has(hist, &fp[2]));
+    echo_msg_history_expire(hist, 20);
+    CHECK(hist->count == 0 && hist->newest == -1);
+
+    free(hist);
+}
+
+/* Items are listed most recent first and restored in the same order */
+static void
+test_persisted_order(void)
+{
+    struct echo_msg_history *hist = echo_msg_history_new();
+    struct echo_msg_history *copy = echo_msg_history_new();
+    struct echo_msg_fp list[ECHO_MSG_HISTORY_MAX + 1];
+
+    for (int i = 1; i <= 4; i++)
+    {
+        list[0] = make_fp(i, i, i);
+        echo_msg_history_save(hist, &list[0]);
+    }
+    list[0] = make_fp(2, 2, 5);
+    echo_msg_history_save(hist, &list[0]);
+    CHECK(order_is(hist, (int[]) {2, 4, 3, 1}, 4));
+
+    size_t len = echo_msg_history_list(hist, list);
+    CHECK(len == 4);
+    CHECK(list[0].timestamp == 5 && list[3].timestamp == 1);
+
+    echo_msg_history_restore(copy, list, len);
+    CHECK(order_is(copy, (int[]) {2, 4, 3, 1}, 4));
+
+    /* duplicates are skipped and the oldest beyond the max dropped */
+    free(copy);
+    copy = echo_msg_history_new();
+    for (int i = 0; i < ECHO_MSG_HISTORY_MAX + 1; i++)
+    {
+        list[i] = make_fp(i, i, 1000 - i);
+    }
+    list[1] = list[0];
+    echo_msg_history_restore(copy, list, ECHO_MSG_HISTORY_MAX + 1);
+    CHECK(copy->count == ECHO_MSG_HISTORY_MAX - 1);
+    CHECK(copy->fp[copy->newest].digest[2] == 0);
+    CHECK(copy->fp[copy->oldest].digest[2] == ECHO_MSG_HISTORY_MAX - 1);
+    CHECK(!has(copy, &list[ECHO_MSG_HISTORY_MAX]));
+
+    free(hist);
+    free(copy);
+}
+
+/* Random operations on few slots agree with a plain list of items */
+static void
+test_random(void)
+{
+    struct echo_msg_history *hist = echo_msg_history_new();
+    int present[64] = { 0 };
+    time_t now = 0;
+
+    srand(1);
+    for (int round = 0; round < 20000; round++)
+    {
+        int id = rand() % 64;
+        /* crowd the items into a few slots around the wrap */
+        struct echo_msg_fp fp = make_fp(ECHO_MSG_HISTORY_SLOTS - 4 + id % 8, id, ++now);
+
+        if (rand() % 3)
+        {
+            echo_msg_history_save(hist, &fp);
+            present[id] = 1;
+        }
+        else if (present[id])
+        {
+            echo_msg_history_remove(hist, echo_msg_history_find(hist, fp.digest));
+            present[id] = 0;
+        }
+
+        int count = 0;
+        for (int i = 0; i < 64; i++)
+        {
+            struct echo_msg_fp other = make_fp(ECHO_MSG_HISTORY_SLOTS - 4 + i % 8, i, 0);
+            if (has(hist, &other) != present[i])
+            {
+                CHECK(has(hist, &other) == present[i]);
+                round = 20000;
+                break;
+            }
+            count += present[i];
+        }
+        CHECK(count == hist->count);
+    }
+
+    free(hist);
+}
+
+int
+main(void)
+{
+    test_insert_lookup_delete();
+    test_wraparound();
+    test_eviction();
+    test_expiry();
+    test_persisted_order();
+    test_random();
+
+    return test_result("test_echo_history");
+}
@@ -0,0 +1,462 @@
+/*
+ *  OpenVPN-GUI -- A Windows GUI for OpenVPN.
+ *
+ *  Copyright (C) 2026 agent <agent@local>
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program (see the file COPYING included with this
+ *  distribution); if not, write to the Free Software Foundation, Inc.,
+ *  59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+#include <stdlib.h>
+#include <string.h>
+
+#include "mgmt_proto.h"
+#include "test.h"
+
+/* Append data to the receive buffer as if read from the socket */
+static void
+feed(mgmt_rbuf_t *rb, const char *data, size_t len)
+{
+    while (len > 0)
+    {
+        size_t avail;
+        char *tail = mgmt_rbuf_reserve(rb, len, &avail);
+        size_t n = len < avail ? len : avail;
+
+        CHECK(avail > 0);
+        if (avail == 0)
+        {
+            return;
+        }
+        memcpy(tail, data, n);
+        mgmt_rbuf_commit(rb, n);
+        data += n;
+        len -= n;
+    }
+}
+
+static void
+feed_str(mgmt_rbuf_t *rb, const char *s)
+{
+    feed(rb, s, strlen(s));
+}
+
+static char *
+getline_str(mgmt_rbuf_t *rb)
+{
+    int prompt;
+    return mgmt_rbuf_getline(rb, &prompt);
+}
+
+/* Lines split across reads are only returned once complete */
+static void
+test_partial_reads(void)
+{
+    mgmt_rbuf_t rb = { 0 };
+    char *line;
+
+    feed_str(&rb, ">STATE:1,CONNECTING\n>LOG:1,I,par");
+    line = getline_str(&rb);
+    CHECK(line && strcmp(line, ">STATE:1,CONNECTING") == 0);
+    CHECK(getline_str(&rb) == NULL);
+
+    feed_str(&rb, "tial");
+    CHECK(getline_str(&rb) == NULL);
+
+    feed_str(&rb, " line\n");
+    line = getline_str(&rb);
+    CHECK(line && strcmp(line, ">LOG:1,I,partial line") == 0);
+    CHECK(getline_str(&rb) == NULL);
+
+    /* byte by byte */
+    const char *s = "SUCCESS: pid=42\n";
+    for (size_t i = 0; s[i]; i++)
+    {
+        CHECK(getline_str(&rb) == NULL);
+        feed(&rb, s + i, 1);
+    }
+    line = getline_str(&rb);
+    CHECK(line && strcmp(line, "SUCCESS: pid=42") == 0);
+
+    mgmt_rbuf_reset(&rb);
+    CHECK(rb.data == NULL && rb.size == 0);
+}
+
+/* A trailing CR is stripped, other CRs are kept */
+static void
+test_crlf(void)
+{
+    mgmt_rbuf_t rb = { 0 };
+    char *line;
+
+    feed_str(&rb, "one\r\ntwo\n\r\nth\rree\r\n");
+    line = getline_str(&rb);
+    CHECK(line && strcmp(line, "one") == 0);
+    line = getline_str(&rb);
+    CHECK(line && strcmp(line, "two") == 0);
+    line = getline_str(&rb);
+    CHECK(line && strcmp(line, "") == 0);
+    line = getline_str(&rb);
+    CHECK(line && strcmp(line, "th\rree") == 0);
+    CHECK(getline_str(&rb) == NULL);
+
+    /* a CR split from its LF by a read */
+    feed_str(&rb, "four\r");
+    CHECK(getline_str(&rb) == NULL);
+    feed_str(&rb, "\n");
+    line = getline_str(&rb);
+    CHECK(line && strcmp(line, "four") == 0);
+
+    mgmt_rbuf_reset(&rb);
+}
+
+/* The password prompt has no newline */
+static void
+test_password_prompt(void)
+{
+    mgmt_rbuf_t rb = { 0 };
+    int prompt = 0;
+
+    feed_str(&rb, "ENTER PASS");
+    CHECK(mgmt_rbuf_getline(&rb, &prompt) == NULL);
+    feed_str(&rb, "WORD:");
+    char *line = mgmt_rbuf_getline(&rb, &prompt);
+    CHECK(line && prompt);
+    CHECK(line && strcmp(line, "ENTER PASSWORD") == 0);
+    CHECK(rb.len == 0);
+
+    feed_str(&rb, "SUCCESS: password is correct\n");
+    line = mgmt_rbuf_getline(&rb, &prompt);
+    CHECK(line && !prompt);
+
+    mgmt_rbuf_reset(&rb);
+}
+
+/* Lines much longer than the initial buffer grow it */
+static void
+test_overlong_lines(void)
+{
+    const size_t len = 200000;
+    mgmt_rbuf_t rb = { 0 };
+    char *data = malloc(len + 1);
+
+    for (size_t i = 0; i < len; i++)
+    {
+        data[i] = 'a' + i % 26;
+    }
+    data[len] = '\n';
+
+    /* arrive in chunks as from recv() */
+    for (size_t off = 0; off <= len; off += 1000)
+    {
+        size_t n = (len + 1 - off < 1000) ? len + 1 - off : 1000;
+        CHECK(off + n > len || getline_str(&rb) == NULL);
+        feed(&rb, data + off, n);
+    }
+
+    char *line = getline_str(&rb);
+    CHECK(line && strlen(line) == len && memcmp(line, data, len) == 0);
+    CHECK(rb.size >= len + 1);
+
+    /* a large buffer is released once drained */
+    mgmt_rbuf_begin(&rb);
+    mgmt_rbuf_end(&rb, 0);
+    CHECK(rb.data == NULL && rb.size == 0);
+
+    free(data);
+}
+
+/* While busy, lines returned earlier stay valid as the buffer grows */
+static void
+test_busy_growth(void)
+{
+    mgmt_rbuf_t rb = { 0 };
+    char big[10000];
+
+    memset(big, 'x', sizeof(big) - 1);
+    big[sizeof(big) - 1] = '\n';
+
+    feed_str(&rb, ">PASSWORD:Need 'Auth' username/password\n>LOG:1,I,more");
+    mgmt_rbuf_begin(&rb);
+    char *line = getline_str(&rb);
+    CHECK(line && strcmp(line, ">PASSWORD:Need 'Auth' username/password") == 0);
+
+    /* a nested read while the handler of line runs */
+    feed(&rb, big, sizeof(big));
+    CHECK(rb.retired != NULL);
+    CHECK(strcmp(line, ">PASSWORD:Need 'Auth' username/password") == 0);
+
+    mgmt_rbuf_begin(&rb);
+    char *next = getline_str(&rb);
+    CHECK(next && strncmp(next, ">LOG:1,I,morexxx", 16) == 0);
+    CHECK(next && strlen(next) == 13 + sizeof(big) - 1);
+    mgmt_rbuf_end(&rb, 0);
+    CHECK(rb.retired != NULL);
+
+    mgmt_rbuf_end(&rb, 0);
+    CHECK(rb.retired == NULL);
+
+    mgmt_rbuf_reset(&rb);
+}
+
+/* Pending data of the queue */
+static const char *
+pending(mgmt_cmd_queue_t *q, int ready)
+{
+    static char buf[1024];
+    const char *data;
+    size_t n = mgmt_cmd_pending(q, ready, buf, sizeof(buf) - 1, &data);
+
+    if (data != buf)
+    {
+        memcpy(buf, data, n);
+    }
+    buf[n] = '\0';
+    return buf;
+}
+
+/* Command at the head of the queue, without the newline */
+static int
+head_is(mgmt_cmd_queue_t *q, const char *command)
+{
+    size_t len = strlen(command);
+    return q->head && (size_t) q->head->len == len + 1
+           && memcmp(q->head->command, command, len) == 0;
+}
+
+static void
+test_command_order(void)
+{
+    mgmt_cmd_queue_t q = { 0 };
+
+    CHECK(mgmt_cmd_add(&q, "state on", NULL, regular, 0, 1));
+    CHECK(mgmt_cmd_add(&q, "log on all", NULL, combined, 0, 1));
+    CHECK(mgmt_cmd_add(&q, "bytecount 5", NULL, regular, 0, 1));
+    CHECK(strcmp(pending(&q, 1), "state on\nlog on all\nbytecount 5\n") == 0);
+
+    /* partial send */
+    mgmt_cmd_sent(&q, 12);
+    CHECK(strcmp(pending(&q, 1), " on all\nbytecount 5\n") == 0);
+    mgmt_cmd_sent(&q, 20);
+    CHECK(strcmp(pending(&q, 1), "") == 0);
+
+    /* responses are matched in order; combined ones take two removes */
+    CHECK(head_is(&q, "state on"));
+    CHECK(mgmt_cmd_remove(&q));
+    CHECK(head_is(&q, "log on all"));
+    CHECK(mgmt_cmd_remove(&q));
+    CHECK(q.head && q.head->type == regular && q.stats.depth == 2);
+    CHECK(mgmt_cmd_remove(&q));
+    CHECK(head_is(&q, "bytecount 5"));
+    CHECK(mgmt_cmd_remove(&q));
+    CHECK(q.head == NULL);
+    CHECK(!mgmt_cmd_remove(&q));
+
+    mgmt_cmd_clear(&q);
+}
+
+/* Early commands go ahead of those held back until ready, in order */
+static void
+test_early_commands(void)
+{
+    mgmt_cmd_queue_t q = { 0 };
+
+    CHECK(mgmt_cmd_add(&q, "held1", NULL, regular, 0, 0));
+    CHECK(mgmt_cmd_add(&q, "held2", NULL, regular, 0, 0));
+    CHECK(strcmp(pending(&q, 0), "") == 0);
+
+    CHECK(mgmt_cmd_add(&q, "early1", NULL, regular, 1, 0));
+    CHECK(mgmt_cmd_add(&q, "early2", NULL, regular, 1, 0));
+    CHECK(strcmp(pending(&q, 0), "early1\nearly2\n") == 0);
+    mgmt_cmd_sent(&q, 14);
+
+    CHECK(mgmt_cmd_add(&q, "early3", NULL, regular, 1, 0));
+    CHECK(strcmp(pending(&q, 0), "early3\n") == 0);
+
+    CHECK(strcmp(pending(&q, 1), "early3\nheld1\nheld2\n") == 0);
+
+    const char *order[] = { "early1", "early2", "early3", "held1", "held2" };
+    for (size_t i = 0; i < sizeof(order) / sizeof(order[0]); i++)
+    {
+        CHECK(head_is(&q, order[i]));
+        mgmt_cmd_remove(&q);
+    }
+    CHECK(q.head == NULL);
+
+    /* once ready, early commands are appended like any other */
+    CHECK(mgmt_cmd_add(&q, "a", NULL, regular, 0, 1));
+    CHECK(mgmt_cmd_add(&q, "b", NULL, regular, 1, 1));
+    CHECK(strcmp(pending(&q, 1), "a\nb\n") == 0);
+
+    mgmt_cmd_clear(&q);
+}
+
+/* A command larger than the send buffer is returned on its own */
+static void
+test_long_command(void)
+{
+    mgmt_cmd_queue_t q = { 0 };
+    char buf[64];
+    char cmd[300];
+    const char *data;
+
+    memset(cmd, 'p', sizeof(cmd) - 1);
+    cmd[sizeof(cmd) - 1] = '\0';
+
+    CHECK(mgmt_cmd_add(&q, "short", NULL, regular, 0, 1));
+    CHECK(mgmt_cmd_add(&q, cmd, NULL, regular, 0, 1));
+    CHECK(q.stats.long_cmds == 1);
+
+    size_t n = mgmt_cmd_pending(&q, 1, buf, sizeof(buf), &data);
+    CHECK(n == 6 && data == buf);
+    mgmt_cmd_sent(&q, n);
+
+    n = mgmt_cmd_pending(&q, 1, buf, sizeof(buf), &data);
+    CHECK(n == sizeof(cmd) && data != buf);
+    CHECK(data[0] == 'p' && data[n - 1] == '\n');
+
+    mgmt_cmd_clear(&q);
+}
+
+/* Released commands are reused, up to MGMT_CMD_POOL_MAX are kept */
+static void
+test_pool_reuse(void)
+{
+    mgmt_cmd_queue_t q = { 0 };
+
+    for (int i = 0; i < 100; i++)
+    {
+        CHECK(mgmt_cmd_add(&q, "status", NULL, regular, 0, 1));
+        CHECK(mgmt_cmd_remove(&q));
+    }
+    CHECK(q.stats.allocs == 1);
+    CHECK(q.stats.reused == 99);
+    CHECK(q.stats.pooled == 1);
+
+    for (int i = 0; i < 20; i++)
+    {
+        CHECK(mgmt_cmd_add(&q, "status", NULL, regular, 0, 1));
+    }
+    CHECK(q.stats.depth == 20 && q.stats.max_depth == 20);
+    CHECK(q.stats.allocs == 20);
+    while (mgmt_cmd_remove(&q))
+    {
+    }
+    CHECK(q.stats.depth == 0);
+    CHECK(q.stats.pooled == MGMT_CMD_POOL_MAX);
+
+    /* released commands are wiped */
+    for (mgmt_cmd_t *cmd = q.free; cmd; cmd = cmd->next)
+    {
+        CHECK(cmd->command == NULL);
+        CHECK(cmd->inline_buf[0] == '\0');
+    }
+
+    mgmt_cmd_clear(&q);
+    CHECK(q.free == NULL && q.stats.pooled == 0);
+}
+
+static int handled[mgmt_rtmsg_type_max];
+static char last_msg[256];
+
+static void
+on_msg(struct connection *c, char *msg)
+{
+    (void) c;
+    snprintf(last_msg, sizeof(last_msg), "%s", msg ? msg : "(null)");
+}
+
+static void
+on_state(struct connection *c, char *msg)
+{
+    handled[state_]++;
+    on_msg(c, msg);
+}
+
+static void
+on_log(struct connection *c, char *msg)
+{
+    handled[log_]++;
+    on_msg(c, msg);
+}
+
+static void
+test_dispatch(void)
+{
+    mgmt_msg_func handler[mgmt_rtmsg_type_max] = { 0 };
+    mgmt_cmd_queue_t q = { 0 };
+    char *msg;
+    char line[64];
+
+    handler[state_] = on_state;
+    handler[log_] = on_log;
+    mgmt_rtmsg_init();
+
+    strcpy(line, ">STATE:1,CONNECTED,SUCCESS");
+    CHECK(mgmt_dispatch_line(NULL, &q, handler, line, &msg) == state_);
+    CHECK(handled[state_] == 1 && strcmp(last_msg, "1,CONNECTED,SUCCESS") == 0);
+
+    strcpy(line, ">INFO:OpenVPN Management Interface");
+    CHECK(mgmt_dispatch_line(NULL, &q, handler, line, &msg) == ready_);
+    CHECK(msg && strcmp(msg, "OpenVPN Management Interface") == 0);
+
+    strcpy(line, ">INFOMSG:WEB_AUTH::url");
+    CHECK(mgmt_dispatch_line(NULL, &q, handler, line, &msg) == infomsg_);
+
+    strcpy(line, ">UNKNOWN:x");
+    CHECK(mgmt_dispatch_line(NULL, &q, handler, line, &msg) == mgmt_rtmsg_type_max);
+
+    /* responses go to the command at the head */
+    CHECK(mgmt_cmd_add(&q, "log on all", on_msg, combined, 0, 1));
+    CHECK(mgmt_cmd_add(&q, "hold release", on_msg, regular, 0, 1));
+
+    strcpy(line, "SUCCESS: real-time log notification set to ON");
+    mgmt_dispatch_line(NULL, &q, handler, line, &msg);
+    CHECK(strcmp(last_msg, "real-time log notification set to ON") == 0);
+    CHECK(q.stats.depth == 2 && q.head->type == regular); /* waits for END */
+
+    strcpy(line, "1700000000,I,history line");
+    mgmt_dispatch_line(NULL, &q, handler, line, &msg);
+    CHECK(strcmp(last_msg, "1700000000,I,history line") == 0);
+
+    strcpy(line, "END");
+    mgmt_dispatch_line(NULL, &q, handler, line, &msg);
+    CHECK(head_is(&q, "hold release"));
+
+    strcpy(line, "ERROR: command failed");
+    mgmt_dispatch_line(NULL, &q, handler, line, &msg);
+    CHECK(handled[log_] == 1 && strstr(last_msg, "ERROR: command failed") == NULL);
+    CHECK(strcmp(last_msg, "(null)") == 0);
+    CHECK(q.head == NULL);
+
+    mgmt_cmd_clear(&q);
+}
+
+int
+main(void)
+{
+    test_partial_reads();
+    test_crlf();
+    test_password_prompt();
+    test_overlong_lines();
+    test_busy_growth();
+    test_command_order();
+    test_early_commands();
+    test_long_command();
+    test_pool_reuse();
+    test_dispatch();
+
+    return test_result("test_mgmt_proto");
+}
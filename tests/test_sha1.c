@@ -0,0 +1,175 @@
+/*
+ *  OpenVPN-GUI -- A Windows GUI for OpenVPN.
+ *
+ *  Copyright (C) 2026 agent <agent@local>
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program (see the file COPYING included with this
+ *  distribution); if not, write to the Free Software Foundation, Inc.,
+ *  59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "sha1.h"
+#include "echo_history.h"
+#include "test.h"
+
+static void
+digest_hex(const unsigned char *md, char *hex)
+{
+    for (int i = 0; i < SHA1_DIGEST_SIZE; i++)
+    {
+        sprintf(hex + 2 * i, "%02x", md[i]);
+    }
+}
+
+static int
+sha1_is(const void *data, size_t len, const char *expected)
+{
+    sha1_ctx ctx;
+    unsigned char md[SHA1_DIGEST_SIZE];
+    char hex[2 * SHA1_DIGEST_SIZE + 1];
+
+    sha1_init(&ctx);
+    sha1_update(&ctx, data, len);
+    sha1_final(&ctx, md);
+    digest_hex(md, hex);
+    if (strcmp(hex, expected) != 0)
+    {
+        fprintf(stderr, "sha1 of %zu bytes: got %s, expected %s\n", len, hex, expected);
+        return 0;
+    }
+    return 1;
+}
+
+/* Test vectors of FIPS 180 */
+static void
+test_vectors(void)
+{
+    CHECK(sha1_is("", 0, "da39a3ee5e6b4b0d3255bfef95601890afd80709"));
+    CHECK(sha1_is("abc", 3, "a9993e364706816aba3e25717850c26c9cd0d89d"));
+    CHECK(sha1_is("abcdbcdecdefdefgefghfghighijhijkijkljklmklmnlmnomnopnopq", 56,
+                  "84983e441c3bd26ebaae4aa1f95129e5e54670f1"));
+
+    const size_t len = 1000000;
+    char *a = malloc(len);
+    memset(a, 'a', len);
+    CHECK(sha1_is(a, len, "34aa973cd4c4daa4f61eeb2bdbad27316534016f"));
+    free(a);
+}
+
+/* Hashing in pieces of any size gives the same digest as at once */
+static void
+test_incremental(void)
+{
+    unsigned char data[1000];
+    unsigned char once[SHA1_DIGEST_SIZE];
+    unsigned char parts[SHA1_DIGEST_SIZE];
+    sha1_ctx ctx;
+
+    for (size_t i = 0; i < sizeof(data); i++)
+    {
+        data[i] = (unsigned char) (i * 31 + 7);
+    }
+
+    /* lengths around the 64 byte block and the 56 byte padding limit */
+    const size_t lengths[] = { 0, 1, 55, 56, 57, 63, 64, 65, 119, 120, 128, 1000 };
+    for (size_t l = 0; l < sizeof(lengths) / sizeof(lengths[0]); l++)
+    {
+        size_t len = lengths[l];
+
+        sha1_init(&ctx);
+        sha1_update(&ctx, data, len);
+        sha1_final(&ctx, once);
+
+        for (size_t step = 1; step <= 70; step += 3)
+        {
+            sha1_init(&ctx);
+            for (size_t off = 0; off < len; off += step)
+            {
+                sha1_update(&ctx, data + off, (len - off < step) ? len - off : step);
+            }
+            sha1_update(&ctx, data, 0);
+            sha1_final(&ctx, parts);
+            CHECK(memcmp(once, parts, SHA1_DIGEST_SIZE) == 0);
+        }
+    }
+
+    /* the context is reset by sha1_final */
+    sha1_init(&ctx);
+    sha1_update(&ctx, "xyz", 3);
+    sha1_final(&ctx, once);
+    sha1_update(&ctx, "abc", 3);
+    sha1_final(&ctx, parts);
+    char hex[2 * SHA1_DIGEST_SIZE + 1];
+    digest_hex(parts, hex);
+    CHECK(strcmp(hex, "a9993e364706816aba3e25717850c26c9cd0d89d") == 0);
+}
+
+/* Fingerprint of a message as echo.c makes it: text as received, then title */
+static struct echo_msg_fp
+message_fp(const char *const *text, const char *title, time_t timestamp)
+{
+    struct echo_msg_fp fp;
+    sha1_ctx ctx;
+
+    sha1_init(&ctx);
+    for (; *text; text++)
+    {
+        sha1_update(&ctx, *text, strlen(*text));
+    }
+    sha1_update(&ctx, title, strlen(title));
+    sha1_final(&ctx, fp.digest);
+    fp.timestamp = timestamp;
+    return fp;
+}
+
+/* Repeated messages are found in history however their text arrived */
+static void
+test_echo_dedupe(void)
+{
+    struct echo_msg_history *hist = echo_msg_history_new();
+    const char *first[] = { "Password expires ", "in 3 days", NULL };
+    const char *again[] = { "Pass", "word expires in 3 days", NULL };
+    const char *other[] = { "Password expires in 2 days", NULL };
+
+    struct echo_msg_fp fp = message_fp(first, "Notice", 100);
+    CHECK(echo_msg_history_find(hist, fp.digest) < 0);
+    echo_msg_history_save(hist, &fp);
+
+    fp = message_fp(again, "Notice", 200);
+    int n = echo_msg_history_find(hist, fp.digest);
+    CHECK(n >= 0 && hist->fp[n].timestamp == 100);
+    echo_msg_history_save(hist, &fp);
+    CHECK(hist->count == 1);
+
+    fp = message_fp(other, "Notice", 300);
+    CHECK(echo_msg_history_find(hist, fp.digest) < 0);
+    fp = message_fp(first, "Warning", 300);
+    CHECK(echo_msg_history_find(hist, fp.digest) < 0);
+
+    free(hist);
+}
+
+int
+main(void)
+{
+    test_vectors();
+    test_incremental();
+    test_echo_dedupe();
+
+    return test_result("test_sha1");
+}
@@ -50,12 +50,47 @@ HMENU *hMenuConn;
 HMENU hMenuImport;
 int hmenu_size = 0; /* allocated size of hMenuConn array */
 
+/* Inputs the popup menus were built from -- rebuilt only when these change */
+static struct {
+    BOOL valid;                     /* cleared when colors or theme change */
+    int num_configs;
+    int num_groups;
+    LANGID language;
+    DWORD config_menu_view;
+} menu_built;
+
 HBITMAP hbmpConnecting;
 
 NOTIFYICONDATA ni;
 HWND traytip; /* handle of tooltip window for tray icon */
 TOOLINFO ti;  /* global tool info structure for tool tip of tray icon*/
 
+/* Minimum interval between tray icon updates in msec */
+#define TRAY_REFRESH_DELAY 100
+
+/* Tray icon handles for the disconnected, connecting and connected states */
+static struct {
+    LANGID language;
+    HICON icon[3];
+} tray_icons;
+
+/* Icon and tooltip last passed to the shell */
+static struct {
+    BOOL valid;
+    UINT icon_id;
+    LONG serial;
+    LANGID language;
+} tray_shown;
+
+static volatile LONG tray_refresh_pending;
+
+/* Counts of tray refresh requests and of actual shell updates */
+static struct {
+    volatile LONG requests;
+    LONG refreshes;
+    LONG updates;
+} tray_stats;
+
 extern options_t o;
 
 #define USE_NESTED_CONFIG_MENU ((o.config_menu_view == CONFIG_VIEW_AUTO && o.num_configs > 25)   \
@@ -224,27 +259,27 @@ CreatePopupMenus()
         SetMenuInfo(hMenu, &minfo);
 
         /* Create Main menu with actions */
-        AppendMenu(hMenu, MF_STRING, IDM_CONNECTMENU, LoadLocalizedString(IDS_MENU_CONNECT));
-        AppendMenu(hMenu, MF_STRING, IDM_DISCONNECTMENU, LoadLocalizedString(IDS_MENU_DISCONNECT));
-        AppendMenu(hMenu, MF_STRING, IDM_RECONNECTMENU, LoadLocalizedString(IDS_MENU_RECONNECT));
-        AppendMenu(hMenu, MF_STRING, IDM_STATUSMENU, LoadLocalizedString(IDS_MENU_STATUS));
+        AppendMenu(hMenu, MF_STRING, IDM_CONNECTMENU, GetLocalizedString(IDS_MENU_CONNECT));
+        AppendMenu(hMenu, MF_STRING, IDM_DISCONNECTMENU, GetLocalizedString(IDS_MENU_DISCONNECT));
+        AppendMenu(hMenu, MF_STRING, IDM_RECONNECTMENU, GetLocalizedString(IDS_MENU_RECONNECT));
+        AppendMenu(hMenu, MF_STRING, IDM_STATUSMENU, GetLocalizedString(IDS_MENU_STATUS));
         AppendMenu(hMenu, MF_SEPARATOR, 0, 0);
 
-        AppendMenu(hMenu, MF_STRING, IDM_VIEWLOGMENU, LoadLocalizedString(IDS_MENU_VIEWLOG));
+        AppendMenu(hMenu, MF_STRING, IDM_VIEWLOGMENU, GetLocalizedString(IDS_MENU_VIEWLOG));
 
-        AppendMenu(hMenu, MF_STRING, IDM_EDITMENU, LoadLocalizedString(IDS_MENU_EDITCONFIG));
-        AppendMenu(hMenu, MF_STRING, IDM_CLEARPASSMENU, LoadLocalizedString(IDS_MENU_CLEARPASS));
+        AppendMenu(hMenu, MF_STRING, IDM_EDITMENU, GetLocalizedString(IDS_MENU_EDITCONFIG));
+        AppendMenu(hMenu, MF_STRING, IDM_CLEARPASSMENU, GetLocalizedString(IDS_MENU_CLEARPASS));
 
         AppendMenu(hMenu, MF_SEPARATOR, 0, 0);
 
         hMenuImport = CreatePopupMenu();
-        AppendMenu(hMenu, MF_POPUP, (UINT_PTR) hMenuImport, LoadLocalizedString(IDS_MENU_IMPORT));
-        AppendMenu(hMenuImport, MF_STRING, IDM_IMPORT_FILE, LoadLocalizedString(IDS_MENU_IMPORT_FILE));
-        AppendMenu(hMenuImport, MF_STRING, IDM_IMPORT_AS, LoadLocalizedString(IDS_MENU_IMPORT_AS));
-        AppendMenu(hMenuImport, MF_STRING, IDM_IMPORT_URL, LoadLocalizedString(IDS_MENU_IMPORT_URL));
+        AppendMenu(hMenu, MF_POPUP, (UINT_PTR) hMenuImport, GetLocalizedString(IDS_MENU_IMPORT));
+        AppendMenu(hMenuImport, MF_STRING, IDM_IMPORT_FILE, GetLocalizedString(IDS_MENU_IMPORT_FILE));
+        AppendMenu(hMenuImport, MF_STRING, IDM_IMPORT_AS, GetLocalizedString(IDS_MENU_IMPORT_AS));
+        AppendMenu(hMenuImport, MF_STRING, IDM_IMPORT_URL, GetLocalizedString(IDS_MENU_IMPORT_URL));
 
-        AppendMenu(hMenu, MF_STRING, IDM_SETTINGS, LoadLocalizedString(IDS_MENU_SETTINGS));
-        AppendMenu(hMenu, MF_STRING, IDM_CLOSE, LoadLocalizedString(IDS_MENU_CLOSE));
+        AppendMenu(hMenu, MF_STRING, IDM_SETTINGS, GetLocalizedString(IDS_MENU_SETTINGS));
+        AppendMenu(hMenu, MF_STRING, IDM_CLOSE, GetLocalizedString(IDS_MENU_CLOSE));
 
         SetMenuStatus(o.chead,  o.chead->state);
     }
@@ -306,32 +341,66 @@ CreatePopupMenus()
         }
 
         hMenuImport = CreatePopupMenu();
-        AppendMenu(hMenu, MF_POPUP, (UINT_PTR) hMenuImport, LoadLocalizedString(IDS_MENU_IMPORT));
-        AppendMenu(hMenuImport, MF_STRING, IDM_IMPORT_FILE, LoadLocalizedString(IDS_MENU_IMPORT_FILE));
-        AppendMenu(hMenuImport, MF_STRING, IDM_IMPORT_AS, LoadLocalizedString(IDS_MENU_IMPORT_AS));
-        AppendMenu(hMenuImport, MF_STRING, IDM_IMPORT_URL, LoadLocalizedString(IDS_MENU_IMPORT_URL));
+        AppendMenu(hMenu, MF_POPUP, (UINT_PTR) hMenuImport, GetLocalizedString(IDS_MENU_IMPORT));
+        AppendMenu(hMenuImport, MF_STRING, IDM_IMPORT_FILE, GetLocalizedString(IDS_MENU_IMPORT_FILE));
+        AppendMenu(hMenuImport, MF_STRING, IDM_IMPORT_AS, GetLocalizedString(IDS_MENU_IMPORT_AS));
+        AppendMenu(hMenuImport, MF_STRING, IDM_IMPORT_URL, GetLocalizedString(IDS_MENU_IMPORT_URL));
 
-        AppendMenu(hMenu, MF_STRING, IDM_SETTINGS, LoadLocalizedString(IDS_MENU_SETTINGS));
-        AppendMenu(hMenu, MF_STRING, IDM_CLOSE, LoadLocalizedString(IDS_MENU_CLOSE));
+        AppendMenu(hMenu, MF_STRING, IDM_SETTINGS, GetLocalizedString(IDS_MENU_SETTINGS));
+        AppendMenu(hMenu, MF_STRING, IDM_CLOSE, GetLocalizedString(IDS_MENU_CLOSE));
 
-        /* Create popup menus for every connection */
+        /* Items of connection popup menus are added when first opened:
+         * only mark the connection state in the parent menus here.
+         */
         for (connection_t *c = o.chead; c; c = c->next)
         {
-            int i = c->id;
-            AppendMenu(hMenuConn[i], MF_STRING, IDM_CONNECTMENU, LoadLocalizedString(IDS_MENU_CONNECT));
-            AppendMenu(hMenuConn[i], MF_STRING, IDM_DISCONNECTMENU, LoadLocalizedString(IDS_MENU_DISCONNECT));
-            AppendMenu(hMenuConn[i], MF_STRING, IDM_RECONNECTMENU, LoadLocalizedString(IDS_MENU_RECONNECT));
-            AppendMenu(hMenuConn[i], MF_STRING, IDM_STATUSMENU, LoadLocalizedString(IDS_MENU_STATUS));
-            AppendMenu(hMenuConn[i], MF_SEPARATOR, 0, 0);
+            SetMenuStatus(c, c->state);
+        }
+    }
+
+    menu_built.valid = TRUE;
+    menu_built.num_configs = o.num_configs;
+    menu_built.num_groups = o.num_groups;
+    menu_built.language = GetGUILanguage();
+    menu_built.config_menu_view = o.config_menu_view;
+}
 
-            AppendMenu(hMenuConn[i], MF_STRING, IDM_VIEWLOGMENU, LoadLocalizedString(IDS_MENU_VIEWLOG));
+/*
+ * Add the action items to the popup menu of a connection when it is about
+ * to be displayed for the first time. Called on WM_INITMENUPOPUP.
+ */
+void
+OnInitMenuPopup(HMENU menu)
+{
+    MENUINFO minfo = {.cbSize = sizeof(MENUINFO), .fMask = MIM_MENUDATA};
 
-            AppendMenu(hMenuConn[i], MF_STRING, IDM_EDITMENU, LoadLocalizedString(IDS_MENU_EDITCONFIG));
-            AppendMenu(hMenuConn[i], MF_STRING, IDM_CLEARPASSMENU, LoadLocalizedString(IDS_MENU_CLEARPASS));
+    if (!GetMenuInfo(menu, &minfo) || !minfo.dwMenuData)
+    {
+        return;
+    }
 
-            SetMenuStatus(c, c->state);
-        }
+    connection_t *c = (connection_t *) minfo.dwMenuData;
+    int i = c->id;
+
+    /* the root menu has the connection as menudata if there is only one */
+    if (o.num_configs == 1 || i >= menu_built.num_configs
+        || hMenuConn[i] != menu || GetMenuItemCount(menu) != 0)
+    {
+        return;
     }
+
+    AppendMenu(hMenuConn[i], MF_STRING, IDM_CONNECTMENU, GetLocalizedString(IDS_MENU_CONNECT));
+    AppendMenu(hMenuConn[i], MF_STRING, IDM_DISCONNECTMENU, GetLocalizedString(IDS_MENU_DISCONNECT));
+    AppendMenu(hMenuConn[i], MF_STRING, IDM_RECONNECTMENU, GetLocalizedString(IDS_MENU_RECONNECT));
+    AppendMenu(hMenuConn[i], MF_STRING, IDM_STATUSMENU, GetLocalizedString(IDS_MENU_STATUS));
+    AppendMenu(hMenuConn[i], MF_SEPARATOR, 0, 0);
+
+    AppendMenu(hMenuConn[i], MF_STRING, IDM_VIEWLOGMENU, GetLocalizedString(IDS_MENU_VIEWLOG));
+
+    AppendMenu(hMenuConn[i], MF_STRING, IDM_EDITMENU, GetLocalizedString(IDS_MENU_EDITCONFIG));
+    AppendMenu(hMenuConn[i], MF_STRING, IDM_CLEARPASSMENU, GetLocalizedString(IDS_MENU_CLEARPASS));
+
+    SetMenuStatus(c, c->state);
 }
 
 
@@ -339,7 +408,8 @@ CreatePopupMenus()
 static void
 DestroyPopupMenus()
 {
-    for (connection_t *c = o.chead; c; c = c->next)
+    /* configs added since the menus were built have no menu yet */
+    for (connection_t *c = o.chead; c && c->id < menu_built.num_configs; c = c->next)
     {
         DestroyMenu(hMenuConn[c->id]);
     }
@@ -351,15 +421,41 @@ DestroyPopupMenus()
     hMenu = NULL;
 }
 
-/* Rescan config folders and recreate popup menus */
+/*
+ * Rescan config folders and recreate popup menus if needed. Configs are
+ * only ever added by a rescan, so the menus are kept unless the number of
+ * configs or groups, the language or the menu view has changed. Connection
+ * state is kept up to date in the menus by SetMenuStatus.
+ */
 void
 RecreatePopupMenus(void)
 {
-    DestroyPopupMenus();
     BuildFileList();
+
+    if (hMenu
+        && menu_built.valid
+        && menu_built.num_configs == o.num_configs
+        && menu_built.num_groups == o.num_groups
+        && menu_built.language == GetGUILanguage()
+        && menu_built.config_menu_view == o.config_menu_view)
+    {
+        return;
+    }
+
+    DestroyPopupMenus();
     CreatePopupMenus();
 }
 
+/*
+ * Have the popup menus rebuilt on next use: their bitmaps depend on the
+ * system colors and theme.
+ */
+void
+InvalidatePopupMenus(void)
+{
+    menu_built.valid = FALSE;
+}
+
 /*
  * Position tool tip window so that it does not overlap with the mouse position
  * and does not spill out of the screen. If mouse location overlaps, NIM_POPUPCLOSE
@@ -483,10 +579,35 @@ RemoveTrayIcon()
 void
 OnDestroyTray()
 {
+    PrintDebug(L"tray: %ld icon updates requested, %ld refreshes, %ld shell updates",
+               tray_stats.requests, tray_stats.refreshes, tray_stats.updates);
+    KillTimer(o.hWnd, IDT_TRAY_REFRESH_TIMER);
     DestroyMenu(hMenu);
     RemoveTrayIcon();
 }
 
+/*
+ * Return the tray icon for the given icon id. Icons are loaded once
+ * per GUI language.
+ */
+static HICON
+TrayIcon(UINT icon_id)
+{
+    int i = (icon_id == ID_ICO_CONNECTED) ? 2 : (icon_id == ID_ICO_CONNECTING) ? 1 : 0;
+    LANGID language = GetGUILanguage();
+
+    if (tray_icons.language != language)
+    {
+        CLEAR(tray_icons);
+        tray_icons.language = language;
+    }
+    if (!tray_icons.icon[i])
+    {
+        tray_icons.icon[i] = LoadLocalizedSmallIcon(icon_id);
+    }
+    return tray_icons.icon[i];
+}
+
 void
 ShowTrayIcon()
 {
@@ -495,11 +616,12 @@ ShowTrayIcon()
     ni.hWnd = o.hWnd;
     ni.uFlags = NIF_MESSAGE | NIF_TIP | NIF_ICON;
     ni.uCallbackMessage = WM_NOTIFYICONTRAY;
-    ni.hIcon = LoadLocalizedSmallIcon(ID_ICO_DISCONNECTED);
+    ni.hIcon = TrayIcon(ID_ICO_DISCONNECTED);
     _tcsncpy(ni.szTip, _T(PACKAGE_NAME), _countof(_T(PACKAGE_NAME)));
     ni.uVersion = NOTIFYICON_VERSION_4;
 
     Shell_NotifyIcon(NIM_ADD, &ni);
+    tray_shown.valid = FALSE;
 
     /* try to set version 4 and a custom tooltip window */
     if (Shell_NotifyIcon(NIM_SETVERSION, &ni))
@@ -532,46 +654,57 @@ ShowTrayIcon()
     }
 }
 
-void
-SetTrayIcon(conn_state_t state)
+/*
+ * Tooltip text and the inputs it was built from. The text depends only on
+ * the connection states (connected_since and the assigned IP are set before
+ * the state changes to connected) and the language, so it is rebuilt only
+ * when either has changed.
+ */
+static struct {
+    BOOL valid;
+    LONG serial;
+    LANGID language;
+    WCHAR text[500];
+} tray_tip;
+
+static void
+BuildTrayTip(WCHAR *tip_msg, size_t size)
 {
-    WCHAR tip_msg[500];
-    TCHAR msg_connected[100];
-    TCHAR msg_connecting[100];
+    LPCTSTR msg_connected = GetLocalizedString(IDS_TIP_CONNECTED);
+    LPCTSTR msg_connecting = GetLocalizedString(IDS_TIP_CONNECTING);
     BOOL first_conn;
-    UINT icon_id;
     connection_t *cc = NULL; /* a connected config */
+    int num_connected = CountConnState(connected);
+    int num_connecting = CountConnState(connecting) + CountConnState(resuming)
+                         + CountConnState(reconnecting);
 
-    _tcsncpy(msg_connected, LoadLocalizedString(IDS_TIP_CONNECTED), _countof(msg_connected));
-    _tcsncpy(msg_connecting, LoadLocalizedString(IDS_TIP_CONNECTING), _countof(msg_connecting));
-
-    wcsncpy_s(tip_msg, _countof(tip_msg), _T(PACKAGE_NAME), _TRUNCATE);
+    wcsncpy_s(tip_msg, size, _T(PACKAGE_NAME), _TRUNCATE);
     first_conn = TRUE;
-    for (connection_t *c = o.chead; c; c = c->next)
+    for (connection_t *c = o.chead; c && num_connected > 0; c = c->next)
     {
         if (c->state == connected)
         {
             /* Append connection name to Icon Tip Msg */
-            _tcsncat(tip_msg, (first_conn ? msg_connected : _T(", ")), _countof(tip_msg) - _tcslen(tip_msg) - 1);
-            _tcsncat(tip_msg, c->config_name, _countof(tip_msg) - _tcslen(tip_msg) - 1);
+            _tcsncat(tip_msg, (first_conn ? msg_connected : _T(", ")), size - _tcslen(tip_msg) - 1);
+            _tcsncat(tip_msg, c->config_name, size - _tcslen(tip_msg) - 1);
             first_conn = FALSE;
             cc = c;
         }
     }
 
     first_conn = TRUE;
-    for (connection_t *c = o.chead; c; c = c->next)
+    for (connection_t *c = o.chead; c && num_connecting > 0; c = c->next)
     {
         if (c->state == connecting || c->state == resuming || c->state == reconnecting)
         {
             /* Append connection name to Icon Tip Msg */
-            _tcsncat(tip_msg, (first_conn ? msg_connecting : _T(", ")), _countof(tip_msg) - _tcslen(tip_msg) - 1);
-            _tcsncat(tip_msg, c->config_name, _countof(tip_msg) - _tcslen(tip_msg) - 1);
+            _tcsncat(tip_msg, (first_conn ? msg_connecting : _T(", ")), size - _tcslen(tip_msg) - 1);
+            _tcsncat(tip_msg, c->config_name, size - _tcslen(tip_msg) - 1);
             first_conn = FALSE;
         }
     }
 
-    if (CountConnState(connected) == 1 && cc)
+    if (num_connected == 1 && cc)
     {
         /* Append "Connected since and assigned IP" to message */
         TCHAR time[50];
@@ -581,20 +714,36 @@ SetTrayIcon(conn_state_t state)
          * This works only if custom tooltip window is in use.
          * Include about 50 characters for "Connected since:" and "Assigned IP:" prefixes.
          */
-        size_t max_msglen = _countof(tip_msg) - (_countof(time) + _countof(ip) + 50);
+        size_t max_msglen = size - (_countof(time) + _countof(ip) + 50);
         if (wcslen(tip_msg)  > max_msglen && traytip)
         {
             wcsncpy_s(&tip_msg[max_msglen-1], 2, L"…", _TRUNCATE);
         }
 
         LocalizedTime(cc->connected_since, time, _countof(time));
-        _tcsncat(tip_msg, LoadLocalizedString(IDS_TIP_CONNECTED_SINCE), _countof(tip_msg) - _tcslen(tip_msg) - 1);
-        _tcsncat(tip_msg, time, _countof(tip_msg) - _tcslen(tip_msg) - 1);
+        _tcsncat(tip_msg, GetLocalizedString(IDS_TIP_CONNECTED_SINCE), size - _tcslen(tip_msg) - 1);
+        _tcsncat(tip_msg, time, size - _tcslen(tip_msg) - 1);
 
         /* concatenate ipv4 and ipv6 addresses into one string */
         wcs_concat2(ip, _countof(ip), cc->ip, cc->ipv6, L", ");
         WCHAR *assigned_ip = LoadLocalizedString(IDS_TIP_ASSIGNED_IP, ip);
-        _tcsncat(tip_msg, assigned_ip, _countof(tip_msg) - _tcslen(tip_msg) - 1);
+        _tcsncat(tip_msg, assigned_ip, size - _tcslen(tip_msg) - 1);
+    }
+}
+
+void
+SetTrayIcon(conn_state_t state)
+{
+    LONG serial = ConnStateSerial();
+    LANGID language = GetGUILanguage();
+    UINT icon_id;
+
+    if (!tray_tip.valid || tray_tip.serial != serial || tray_tip.language != language)
+    {
+        BuildTrayTip(tray_tip.text, _countof(tray_tip.text));
+        tray_tip.serial = serial;
+        tray_tip.language = language;
+        tray_tip.valid = TRUE;
     }
 
     icon_id = ID_ICO_CONNECTING;
@@ -607,21 +756,33 @@ SetTrayIcon(conn_state_t state)
         icon_id = ID_ICO_DISCONNECTED;
     }
 
+    /* nothing to do if the shell already shows this icon and tip */
+    if (tray_shown.valid && tray_shown.icon_id == icon_id
+        && tray_shown.serial == serial && tray_shown.language == language)
+    {
+        return;
+    }
+    tray_shown.valid = TRUE;
+    tray_shown.icon_id = icon_id;
+    tray_shown.serial = serial;
+    tray_shown.language = language;
+    tray_stats.updates++;
+
     ni.cbSize = sizeof(ni);
     ni.uID = 0;
     ni.hWnd = o.hWnd;
-    ni.hIcon = LoadLocalizedSmallIcon(icon_id);
+    ni.hIcon = TrayIcon(icon_id);
     ni.uFlags = NIF_MESSAGE | NIF_ICON;
     ni.uCallbackMessage = WM_NOTIFYICONTRAY;
 
     if (traytip)
     {
-        ti.lpszText = tip_msg;
+        ti.lpszText = tray_tip.text;
         SendMessage(traytip, TTM_UPDATETIPTEXT, 0, (LPARAM) &ti);
     }
     else
     {
-        wcsncpy_s(ni.szTip, _countof(ni.szTip), tip_msg, _TRUNCATE);
+        wcsncpy_s(ni.szTip, _countof(ni.szTip), tray_tip.text, _TRUNCATE);
         ni.uFlags |= NIF_TIP;
     }
 
@@ -629,8 +790,9 @@ SetTrayIcon(conn_state_t state)
 }
 
 
-void
-CheckAndSetTrayIcon()
+/* Set the tray icon and tip to reflect the current state of all connections */
+static void
+UpdateTrayIcon(void)
 {
     if (CountConnState(connected) != 0)
     {
@@ -650,6 +812,48 @@ CheckAndSetTrayIcon()
     }
 }
 
+static void CALLBACK
+TrayRefreshTimer(HWND hwnd, UINT UNUSED msg, UINT_PTR id, DWORD UNUSED now)
+{
+    KillTimer(hwnd, id);
+    InterlockedExchange(&tray_refresh_pending, 0);
+    tray_stats.refreshes++;
+    UpdateTrayIcon();
+}
+
+/*
+ * Request an update of the tray icon. May be called from any thread.
+ * Requests are coalesced and the tray is updated from the main window
+ * at most once every TRAY_REFRESH_DELAY msec, so that a burst of state
+ * changes (many profiles starting or reconnecting at once) results in
+ * a single update of the shell icon.
+ */
+void
+CheckAndSetTrayIcon()
+{
+    InterlockedIncrement(&tray_stats.requests);
+
+    if (InterlockedExchange(&tray_refresh_pending, 1) != 0)
+    {
+        return; /* an update is already scheduled */
+    }
+    if (!o.hWnd || !PostMessage(o.hWnd, WM_OVPN_TRAYICON, 0, 0))
+    {
+        InterlockedExchange(&tray_refresh_pending, 0);
+        UpdateTrayIcon();
+    }
+}
+
+/* Called on the main window when a tray icon update is requested */
+void
+OnTrayIconRefresh(void)
+{
+    if (!SetTimer(o.hWnd, IDT_TRAY_REFRESH_TIMER, TRAY_REFRESH_DELAY, TrayRefreshTimer))
+    {
+        TrayRefreshTimer(o.hWnd, WM_TIMER, IDT_TRAY_REFRESH_TIMER, 0);
+    }
+}
+
 
 void
 ShowTrayBalloon(TCHAR *infotitle_msg, TCHAR *info_msg)
@@ -47,8 +47,12 @@
 
 void RecreatePopupMenus(void);
 
+void InvalidatePopupMenus(void);
+
 void CreatePopupMenus();
 
+void OnInitMenuPopup(HMENU);
+
 void OnNotifyTray(LPARAM);
 
 void OnDestroyTray(void);
@@ -67,4 +71,6 @@ void ShowTrayBalloon(TCHAR *, TCHAR *);
 
 void CheckAndSetTrayIcon();
 
+void OnTrayIconRefresh(void);
+
 #endif /* ifndef TRAY_H */
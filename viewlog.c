@@ -25,6 +25,8 @@
 
 #include <windows.h>
 #include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
 #include <shellapi.h>
 #include <objbase.h>
 
@@ -37,10 +39,238 @@
 
 extern options_t o;
 
+/*
+ * Log files larger than this are not opened in the viewer as a whole:
+ * only the last LOG_TAIL_SIZE bytes are shown.
+ */
+#define LOG_VIEW_MAX_SIZE (64*1024*1024)
+#define LOG_TAIL_SIZE     (8*1024*1024)
+#define LOG_COPY_SIZE     (64*1024)
+
+/* Reader for the end of a log file that may be growing */
+typedef struct {
+    HANDLE fd;
+    LONGLONG offset;                /* position of the next byte to read */
+} log_tail_t;
+
+/*
+ * Read the log file contents at the current position, up to and including
+ * the last complete line in buf. Returns the number of bytes read.
+ */
+static DWORD
+LogTailRead(log_tail_t *t, char *buf, DWORD size)
+{
+    LARGE_INTEGER pos;
+    DWORD n = 0;
+
+    pos.QuadPart = t->offset;
+    if (!SetFilePointerEx(t->fd, pos, NULL, FILE_BEGIN)
+        || !ReadFile(t->fd, buf, size, &n, NULL))
+    {
+        return 0;
+    }
+
+    /* hold back a partial last line, unless buf holds no complete line */
+    for (DWORD i = n; i > 0; i--)
+    {
+        if (buf[i - 1] == '\n')
+        {
+            n = i;
+            break;
+        }
+    }
+    t->offset += n;
+    return n;
+}
+
+/*
+ * Open a log file for reading its last window bytes, starting at a line
+ * boundary. The file is shared with openvpn.exe which may be writing to it.
+ */
+static BOOL
+LogTailOpen(log_tail_t *t, const WCHAR *path, LONGLONG window)
+{
+    LARGE_INTEGER size, pos;
+    char buf[4096];
+    DWORD n;
+
+    t->offset = 0;
+    t->fd = CreateFileW(path, GENERIC_READ, FILE_SHARE_READ|FILE_SHARE_WRITE|FILE_SHARE_DELETE,
+                        NULL, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL);
+    if (t->fd == INVALID_HANDLE_VALUE)
+    {
+        return FALSE;
+    }
+
+    if (GetFileSizeEx(t->fd, &size) && size.QuadPart > window)
+    {
+        /* Skip the partial line at the start of the window: scanning from
+         * the byte before it, drop everything up to and including the first
+         * newline. Nothing is dropped if the window starts a line.
+         */
+        pos.QuadPart = t->offset = size.QuadPart - window - 1;
+        if (!SetFilePointerEx(t->fd, pos, NULL, FILE_BEGIN))
+        {
+            CloseHandle(t->fd);
+            return FALSE;
+        }
+        while (ReadFile(t->fd, buf, sizeof(buf), &n, NULL) && n > 0)
+        {
+            const char *nl = memchr(buf, '\n', n);
+            if (nl)
+            {
+                t->offset += nl - buf + 1;
+                break;
+            }
+            t->offset += n;
+        }
+    }
+    return TRUE;
+}
+
+static void
+LogTailClose(log_tail_t *t)
+{
+    CloseHandle(t->fd);
+    t->fd = INVALID_HANDLE_VALUE;
+}
+
+/*
+ * Path of the copy of the tail of a large log file of c in the temp
+ * directory. Returns false if it does not fit in len characters.
+ */
+static BOOL
+LogTailPath(connection_t *c, WCHAR *tail_path, DWORD len)
+{
+    WCHAR temp_dir[MAX_PATH];
+
+    if (!GetTempPathW(_countof(temp_dir), temp_dir)
+        || _snwprintf(tail_path, len, L"%ls%ls-tail.log", temp_dir, c->config_name) < 0)
+    {
+        return FALSE;
+    }
+    tail_path[len - 1] = L'\0';
+    return TRUE;
+}
+
+/*
+ * Start the copy of a log tail with a note saying what it holds
+ */
+static BOOL
+WriteLogTailNote(HANDLE out, const WCHAR *log_path, char *buf, DWORD size)
+{
+    WCHAR note[2*MAX_PATH];
+    DWORD n, written;
+
+    _snwprintf(note, _countof(note),
+               L"\xFEFF*** Log file too large to view: showing its last %d MB. Full log: %ls ***\r\n",
+               LOG_TAIL_SIZE / (1024*1024), log_path);
+    note[_countof(note) - 1] = L'\0';
+
+    n = (DWORD) WideCharToMultiByte(CP_UTF8, 0, note, -1, buf, (int) size, NULL, NULL);
+    return n > 1 && WriteFile(out, buf, n - 1, &written, NULL) && written == n - 1;
+}
+
+/*
+ * If the log file of c is too large to be opened in the viewer, copy its
+ * last part to a file in the temp directory and return its path in
+ * tail_path. Returns false if the whole log should be viewed. Only a fixed
+ * size buffer is used, independent of the size of the log.
+ */
+static BOOL
+CopyLogTail(connection_t *c, WCHAR *tail_path, DWORD len)
+{
+    WIN32_FILE_ATTRIBUTE_DATA attr;
+    log_tail_t t;
+    char *buf;
+    DWORD n, written;
+    BOOL ret = TRUE;
+
+    if (!GetFileAttributesExW(c->log_path, GetFileExInfoStandard, &attr)
+        || ((ULONGLONG) attr.nFileSizeHigh << 32 | attr.nFileSizeLow) <= LOG_VIEW_MAX_SIZE)
+    {
+        return FALSE;
+    }
+
+    if (!LogTailPath(c, tail_path, len)
+        || !LogTailOpen(&t, c->log_path, LOG_TAIL_SIZE))
+    {
+        return FALSE;
+    }
+
+    buf = malloc(LOG_COPY_SIZE);
+    if (!buf)
+    {
+        LogTailClose(&t);
+        return FALSE;
+    }
+
+    HANDLE out = CreateFileW(tail_path, GENERIC_WRITE, FILE_SHARE_READ, NULL,
+                             CREATE_ALWAYS, FILE_ATTRIBUTE_NORMAL, NULL);
+    if (out == INVALID_HANDLE_VALUE)
+    {
+        free(buf);
+        LogTailClose(&t);
+        return FALSE;
+    }
+
+    if (!WriteLogTailNote(out, c->log_path, buf, LOG_COPY_SIZE))
+    {
+        ret = FALSE;
+    }
+
+    /* copy what was there when opened -- the file may be growing */
+    for (LONGLONG left = ret ? LOG_TAIL_SIZE : 0; left > 0; left -= n)
+    {
+        n = LogTailRead(&t, buf, (DWORD) min(left, (LONGLONG) LOG_COPY_SIZE));
+        if (n == 0)
+        {
+            break;
+        }
+        if (!WriteFile(out, buf, n, &written, NULL) || written != n)
+        {
+            ret = FALSE;
+            break;
+        }
+    }
+
+    CloseHandle(out);
+    free(buf);
+    LogTailClose(&t);
+    if (!ret)
+    {
+        DeleteFileW(tail_path);
+        return FALSE;
+    }
+    PrintDebug(L"Log file of '%ls' is too large to view: showing its tail in '%ls'",
+               c->config_name, tail_path);
+    return TRUE;
+}
+
+/*
+ * Delete the copies of log tails made for viewing. A copy in use by a
+ * viewer is kept; it is overwritten when the log is viewed again.
+ */
+void
+DeleteLogTails(void)
+{
+    WCHAR tail_path[MAX_PATH];
+
+    for (connection_t *c = o.chead; c; c = c->next)
+    {
+        if (LogTailPath(c, tail_path, _countof(tail_path)))
+        {
+            DeleteFileW(tail_path);
+        }
+    }
+}
+
 void
 ViewLog(connection_t *c)
 {
     TCHAR filename[2*MAX_PATH];
+    WCHAR tail_path[MAX_PATH];
+    const WCHAR *log_path = c->log_path;
 
     STARTUPINFO start_info;
     PROCESS_INFORMATION proc_info;
@@ -53,9 +283,14 @@ ViewLog(connection_t *c)
     CLEAR(sa);
     CLEAR(sd);
 
+    if (CopyLogTail(c, tail_path, _countof(tail_path)))
+    {
+        log_path = tail_path;
+    }
+
     /* Try first using file association */
     CoInitializeEx(NULL, COINIT_APARTMENTTHREADED | COINIT_DISABLE_OLE1DDE); /* Safe to init COM multiple times */
-    status = ShellExecuteW(o.hWnd, L"open", c->log_path, NULL, o.log_dir, SW_SHOWNORMAL);
+    status = ShellExecuteW(o.hWnd, L"open", log_path, NULL, o.log_dir, SW_SHOWNORMAL);
 
     if (status > (HINSTANCE) 32) /* Success */
     {
@@ -67,7 +302,7 @@ ViewLog(connection_t *c)
                    " for config '%ls' (status = %lu)", c->config_name, status);
     }
 
-    _sntprintf_0(filename, _T("%ls \"%ls\""), o.log_viewer, c->log_path);
+    _sntprintf_0(filename, _T("%ls \"%ls\""), o.log_viewer, log_path);
 
     /* fill in STARTUPINFO struct */
     GetStartupInfo(&start_info);
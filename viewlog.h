@@ -22,4 +22,5 @@
 struct connection;
 
 void ViewLog(struct connection *c);
+void DeleteLogTails(void);
 void EditConfig(struct connection *c);